@@ -0,0 +1,61 @@
+#include "allocationCounter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// The array versions and the nothrow versions forward to these. They live in their own translation unit so they are
+// never inlined into the callers, where the compiler would pair the new expressions with the calls to free.
+static std::atomic<std::uint64_t> count = 0;
+
+std::uint64_t allocationCount() {
+    return count.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* pointer = std::malloc(std::max<std::size_t>(size, 1))) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    const std::size_t bytes = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+    void* pointer = _aligned_malloc(std::max<std::size_t>(size, 1), bytes);
+#else
+    // the size has to be a multiple of the alignment
+    void* pointer = std::aligned_alloc(bytes, (std::max<std::size_t>(size, 1) + bytes - 1) / bytes * bytes);
+#endif
+    if (pointer != nullptr) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    operator delete(pointer);
+}
+
+// the aligned versions are only called with pointers of the aligned operator new
+void operator delete(void* pointer, std::align_val_t) noexcept {
+#ifdef _WIN32
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept {
+    operator delete(pointer, alignment);
+}
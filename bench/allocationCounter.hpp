@@ -0,0 +1,6 @@
+#pragma once
+#include <cstdint>
+
+// Number of heap allocations of the whole process so far. allocationCounter.cpp replaces the global operator new
+// to count them, so it has to be linked into every executable that calls this.
+std::uint64_t allocationCount();
@@ -0,0 +1,424 @@
+#include "barnesHut.hpp"
+#include "blockLeapfrog.hpp"
+#include "directSum.hpp"
+#include "ensemble.hpp"
+#include "mixedPrecision.hpp"
+#include "particleMesh.hpp"
+#include "simdKernel.hpp"
+#include "simulation.hpp"
+
+#include "allocationCounter.hpp"
+#include "scenarios.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Runs every combination of scenario, body count, force engine, integrator and thread count and prints the
+// results as JSON. With several members every run advances that many variants of the scenario, generated from
+// consecutive seeds, as one Ensemble. Every engine after the direct sum is also compared to it by its speedup,
+// which together with the energy drift shows what approximations and single precision cost. The peak resident set
+// size belongs to the whole process, so it never decreases between runs.
+
+static constexpr int dimension = 3;
+using ValueType = double;
+using State = SoAState<dimension, ValueType, Body>;
+using Accelerations = VectorColumns<dimension, ValueType>;
+
+static constexpr ValueType softening = 0.05;
+static constexpr float stepSize = 0.001f;
+// steps before the measurement, the buffers that grow during the first evaluations reach their size within them
+static constexpr int warmUpSteps = 5;
+
+struct Options {
+    std::vector<std::string> scenarios = {"disk", "plummer", "galaxies", "binary"};
+    std::vector<int> counts = {100, 1000, 10000};
+    std::vector<std::string> engines = {"direct", "simd", "mixed", "barnes-hut", "pm", "p3m"};
+    std::vector<std::string> integrators = {"verlet", "leapfrog", "runge-kutta", "yoshida", "block"};
+    std::vector<int> threadCounts = {1, static_cast<int>(std::thread::hardware_concurrency())};
+    int members = 1;
+    int steps = 10;
+    double maxSeconds = 30;
+    unsigned long long seed = 42;
+    std::string outputPath;
+};
+
+struct Result {
+    int steps;
+    double seconds;
+    double interactions;
+    double energyDrift;
+    // heap allocations of the measured steps, which should not allocate once the buffers of the simulation are sized
+    std::uint64_t allocations;
+    // highest block time step level after the last step, -1 for integrators without levels
+    int maxLevel;
+};
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> result;
+    std::stringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ',')) {
+        result.push_back(item);
+    }
+
+    return result;
+}
+
+long peakResidentSetSize() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // kilobytes on Linux
+    return usage.ru_maxrss;
+#endif
+}
+
+int maxLevel(const std::vector<int>& levels) {
+    return levels.empty() ? 0 : *std::max_element(levels.begin(), levels.end());
+}
+
+// total energy with the softened potential of the force engines
+ValueType energy(const State& state, ThreadPool& threadPool) {
+    const int count = state.size();
+    const int chunkSize = 256;
+    const int chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    // one sum per chunk keeps the result independent of the thread count
+    std::vector<ValueType> sums(chunkCount, 0);
+    threadPool.run(chunkCount, [&](int chunk, int) {
+        const int end = std::min((chunk + 1) * chunkSize, count);
+
+        for (int i = chunk * chunkSize; i < end; i++) {
+            ValueType kinetic = 0;
+            for (int d = 0; d < dimension; d++) {
+                kinetic += state.velocities[d][i] * state.velocities[d][i];
+            }
+            sums[chunk] += state.masses[i] * kinetic / 2;
+
+            for (int j = 0; j < i; j++) {
+                ValueType distanceSquared = softening * softening;
+                for (int d = 0; d < dimension; d++) {
+                    const ValueType difference = state.positions[d][i] - state.positions[d][j];
+                    distanceSquared += difference * difference;
+                }
+
+                sums[chunk] -= state.masses[i] * state.masses[j] / std::sqrt(distanceSquared);
+            }
+        }
+    });
+
+    ValueType result = 0;
+    for (ValueType sum : sums) {
+        result += sum;
+    }
+
+    return result;
+}
+
+// counts the pair interactions a direct sum would need for the evaluations of the wrapped engine
+template<typename TEngine>
+struct CountingEngine {
+    mutable TEngine engine;
+    double* interactions;
+
+    inline void operator()(const State& state, Accelerations& accelerations, ThreadPool& threadPool) const {
+        *interactions += static_cast<double>(state.size()) * (state.size() - 1);
+        engine(state, accelerations, threadPool);
+    }
+
+    inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) const
+        requires requires { engine(state, targets, accelerations, threadPool); }
+    {
+        *interactions += static_cast<double>(targets.size()) * (state.size() - 1);
+        engine(state, targets, accelerations, threadPool);
+    }
+};
+
+template<template<int, typename, typename> typename TIntegrator, typename TEngine>
+Result runSingle(const Bodies& bodies, const TEngine& engine, int threadCount, const Options& options) {
+    Result result = {0, 0, 0, 0, 0, -1};
+
+    Simulation<dimension, ValueType, Body, TIntegrator> sim(bodies, engine, stepSize);
+    sim.setForceEngine(CountingEngine<TEngine>{engine, &result.interactions});
+    sim.setThreadCount(threadCount);
+
+    // only the latest state is needed
+    HistoryPolicy history;
+    history.keyframeInterval = warmUpSteps + options.steps + 1;
+    sim.setHistoryPolicy(history);
+
+    if constexpr (requires { sim.getIntegrator().setSoftening(softening); }) {
+        sim.getIntegrator().setSoftening(softening);
+    }
+
+    const ValueType initialEnergy = energy(sim.getState(0), sim.getThreadPool());
+
+    for (int i = 0; i < warmUpSteps; i++) {
+        sim.step();
+    }
+    result.interactions = 0;
+
+    const std::uint64_t allocations = allocationCount();
+    const auto start = std::chrono::steady_clock::now();
+    while (result.steps < options.steps && result.seconds < options.maxSeconds) {
+        sim.step();
+        result.steps++;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    result.allocations = allocationCount() - allocations;
+
+    if constexpr (requires { sim.getIntegrator().getLevels(); }) {
+        result.maxLevel = maxLevel(sim.getIntegrator().getLevels());
+    }
+
+    const ValueType finalEnergy = energy(sim.getState(sim.endTime()), sim.getThreadPool());
+    result.energyDrift = std::abs((finalEnergy - initialEnergy) / initialEnergy);
+
+    return result;
+}
+
+// the steps are steps of the whole ensemble and the energy drift is the mean of the members
+template<template<int, typename, typename> typename TIntegrator, typename TEngine>
+Result runEnsemble(const std::vector<Bodies>& members, const TEngine& engine, int threadCount, const Options& options) {
+    Result result = {0, 0, 0, 0, 0, -1};
+
+    using Ensemble = Ensemble<dimension, ValueType, Body, TIntegrator>;
+    Ensemble ensemble(std::make_shared<ThreadPool>(threadCount));
+
+    // one counter per member, the members are stepped concurrently
+    std::vector<double> interactions(members.size(), 0);
+
+    HistoryPolicy history;
+    history.keyframeInterval = warmUpSteps + options.steps + 1;
+
+    for (std::size_t m = 0; m < members.size(); m++) {
+        auto& sim = ensemble.getMember(ensemble.emplace(State(members[m]), engine, stepSize));
+        sim.setForceEngine(CountingEngine<TEngine>{engine, &interactions[m]});
+        sim.setHistoryPolicy(history);
+
+        if constexpr (requires { sim.getIntegrator().setSoftening(softening); }) {
+            sim.getIntegrator().setSoftening(softening);
+        }
+    }
+
+    const auto energies = [&]() {
+        return ensemble.evaluate([](const typename Ensemble::Member& sim) {
+            return static_cast<double>(energy(sim.getState(sim.endTime()), sim.getThreadPool()));
+        });
+    };
+    const std::vector<double> initialEnergies = energies();
+
+    for (int i = 0; i < warmUpSteps; i++) {
+        ensemble.advance();
+    }
+    std::fill(interactions.begin(), interactions.end(), 0.0);
+
+    const std::uint64_t allocations = allocationCount();
+    const auto start = std::chrono::steady_clock::now();
+    while (result.steps < options.steps && result.seconds < options.maxSeconds) {
+        ensemble.advance();
+        result.steps++;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    result.allocations = allocationCount() - allocations;
+
+    for (int m = 0; m < ensemble.size(); m++) {
+        if constexpr (requires { ensemble.getMember(m).getIntegrator().getLevels(); }) {
+            result.maxLevel = std::max(result.maxLevel, maxLevel(ensemble.getMember(m).getIntegrator().getLevels()));
+        }
+    }
+
+    const std::vector<double> finalEnergies = energies();
+    std::vector<double> drifts(members.size());
+    for (std::size_t m = 0; m < members.size(); m++) {
+        drifts[m] = std::abs((finalEnergies[m] - initialEnergies[m]) / initialEnergies[m]);
+        result.interactions += interactions[m];
+    }
+    result.energyDrift = Ensemble::summarize(drifts).mean;
+
+    return result;
+}
+
+template<template<int, typename, typename> typename TIntegrator, typename TEngine>
+Result run(const std::vector<Bodies>& members, const TEngine& engine, int threadCount, const Options& options) {
+    if (members.size() == 1) {
+        return runSingle<TIntegrator>(members[0], engine, threadCount, options);
+    }
+
+    return runEnsemble<TIntegrator>(members, engine, threadCount, options);
+}
+
+template<typename TEngine>
+Result run(const std::string& integrator, const std::vector<Bodies>& bodies, const TEngine& engine, int threadCount, const Options& options) {
+    if (integrator == "verlet") {
+        return run<VelocityVerlet>(bodies, engine, threadCount, options);
+    }
+    if (integrator == "leapfrog") {
+        return run<Leapfrog>(bodies, engine, threadCount, options);
+    }
+    if (integrator == "runge-kutta") {
+        return run<RungeKutta4>(bodies, engine, threadCount, options);
+    }
+    if (integrator == "yoshida") {
+        return run<Yoshida4>(bodies, engine, threadCount, options);
+    }
+    if (integrator == "block") {
+        return run<BlockLeapfrog>(bodies, engine, threadCount, options);
+    }
+
+    throw std::runtime_error("Unknown integrator " + integrator);
+}
+
+Result run(const std::string& engine, const std::string& integrator, const std::vector<Bodies>& bodies, int threadCount, const Options& options) {
+    if (engine == "direct") {
+        return run(integrator, bodies, DirectSum<dimension, ValueType, Body>(1, softening), threadCount, options);
+    }
+    if (engine == "simd") {
+        return run(integrator, bodies, SimdDirectSum<dimension, ValueType, Body>(1, softening), threadCount, options);
+    }
+    if (engine == "mixed") {
+        return run(integrator, bodies, MixedPrecisionDirectSum<dimension, ValueType, Body>(1, softening), threadCount, options);
+    }
+    if (engine == "barnes-hut") {
+        return run(integrator, bodies, BarnesHut<dimension, ValueType, Body>(1, 0.5, softening), threadCount, options);
+    }
+    if (engine == "pm") {
+        return run(integrator, bodies, ParticleMesh<dimension, ValueType, Body>(1, 64, softening), threadCount, options);
+    }
+    if (engine == "p3m") {
+        return run(integrator, bodies, ParticleMesh<dimension, ValueType, Body>(1, 64, softening, 1.25), threadCount, options);
+    }
+
+    throw std::runtime_error("Unknown force engine " + engine);
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+
+        const std::string value = argv[++i];
+        if (arg == "--scenarios") {
+            options.scenarios = split(value);
+        }
+        else if (arg == "--counts") {
+            options.counts.clear();
+            for (const std::string& count : split(value)) {
+                options.counts.push_back(static_cast<int>(std::stod(count)));
+            }
+        }
+        else if (arg == "--engines") {
+            options.engines = split(value);
+        }
+        else if (arg == "--integrators") {
+            options.integrators = split(value);
+        }
+        else if (arg == "--threads") {
+            options.threadCounts.clear();
+            for (const std::string& threadCount : split(value)) {
+                options.threadCounts.push_back(std::stoi(threadCount));
+            }
+        }
+        else if (arg == "--members") {
+            options.members = std::max(1, std::stoi(value));
+        }
+        else if (arg == "--steps") {
+            options.steps = std::stoi(value);
+        }
+        else if (arg == "--max-seconds") {
+            options.maxSeconds = std::stod(value);
+        }
+        else if (arg == "--seed") {
+            options.seed = std::stoull(value);
+        }
+        else if (arg == "--output") {
+            options.outputPath = value;
+        }
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!options.outputPath.empty()) {
+        file.open(options.outputPath);
+    }
+    std::ostream& output = options.outputPath.empty() ? std::cout : file;
+
+    output << "{\n  \"seed\": " << options.seed << ",\n  \"stepSize\": " << stepSize << ",\n  \"softening\": " << softening << ",\n  \"instructionSet\": \"" << getInstructionSetName(detectInstructionSet()) << "\",\n  \"results\": [";
+
+    bool first = true;
+    for (const std::string& scenario : options.scenarios) {
+        for (int count : options.counts) {
+            std::vector<Bodies> bodies;
+            for (int m = 0; m < options.members; m++) {
+                bodies.push_back(createScenario(scenario, count, softening, options.seed + m));
+            }
+
+            // steps per second of the direct sum for every integrator and thread count
+            std::map<std::pair<std::string, int>, double> directStepsPerSecond;
+
+            for (const std::string& engine : options.engines) {
+                for (const std::string& integrator : options.integrators) {
+                    for (int threadCount : options.threadCounts) {
+                        const Result result = run(engine, integrator, bodies, threadCount, options);
+                        const double stepsPerSecond = result.steps * options.members / result.seconds;
+
+                        if (engine == "direct") {
+                            directStepsPerSecond[{integrator, threadCount}] = stepsPerSecond;
+                        }
+                        const auto direct = directStepsPerSecond.find({integrator, threadCount});
+
+                        output << (first ? "\n" : ",\n") << "    {\"scenario\": \"" << scenario << "\", \"bodies\": " << count << ", \"engine\": \"" << engine
+                               << "\", \"integrator\": \"" << integrator << "\", \"threads\": " << threadCount << ", \"members\": " << options.members << ", \"steps\": " << result.steps
+                               << ", \"seconds\": " << result.seconds << ", \"stepsPerSecond\": " << stepsPerSecond
+                               << ", \"pairInteractionsPerSecond\": " << result.interactions / result.seconds
+                               << ", \"peakRssKiB\": " << peakResidentSetSize() << ", \"energyDrift\": " << result.energyDrift
+                               << ", \"allocationsPerStep\": " << static_cast<double>(result.allocations) / result.steps;
+                        if (direct != directStepsPerSecond.end()) {
+                            output << ", \"speedup\": " << stepsPerSecond / direct->second;
+                        }
+                        if (result.maxLevel >= 0) {
+                            output << ", \"maxLevel\": " << result.maxLevel;
+                        }
+                        output << "}";
+                        output.flush();
+                        first = false;
+                    }
+                }
+            }
+        }
+    }
+
+    output << "\n  ]\n}" << std::endl;
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include "object.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+// point mass without geometry, the benchmark does not draw anything
+struct Body {
+    float mass;
+    float radius;
+
+    template<int dim, typename TValue>
+    inline unsigned int getGeometry(const glm::vec<dim, TValue>&,
+                                    std::vector<glm::vec<dim, TValue>>&,
+                                    std::vector<unsigned int>&,
+                                    unsigned int) const {
+        return 0;
+    }
+};
+
+// bodies never merge in the benchmark
+template<int dim, typename TValue>
+inline bool collide(const Object<dim, TValue, Body>&, const Object<dim, TValue, Body>&) {
+    return false;
+}
+
+// All scenarios use G = 1 and a total mass of 1.
+using Bodies = std::vector<Object<3, double, Body>>;
+
+inline glm::dvec3 isotropic(double length, std::mt19937_64& random) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    const double z = 2.0 * uniform(random) - 1.0;
+    const double angle = 2.0 * glm::pi<double>() * uniform(random);
+    const double radius = std::sqrt(1.0 - z * z);
+
+    return length * glm::dvec3(radius * std::cos(angle), radius * std::sin(angle), z);
+}
+
+inline void toCenterOfMassFrame(Bodies& bodies) {
+    glm::dvec3 position(0.0);
+    glm::dvec3 velocity(0.0);
+    double mass = 0;
+
+    for (const auto& body : bodies) {
+        position += static_cast<double>(body.attributes.mass) * body.position;
+        velocity += static_cast<double>(body.attributes.mass) * body.velocity;
+        mass += body.attributes.mass;
+    }
+
+    for (auto& body : bodies) {
+        body.position -= position / mass;
+        body.velocity -= velocity / mass;
+    }
+}
+
+// cold disk of radius 1 in the xy plane, every body starts on the circular orbit of the mass inside it
+inline Bodies uniformDisk(int count, std::mt19937_64& random) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    Bodies bodies;
+    bodies.reserve(count);
+
+    for (int i = 0; i < count; i++) {
+        const double radius = std::sqrt(uniform(random));
+        const double angle = 2.0 * glm::pi<double>() * uniform(random);
+        const glm::dvec3 direction(std::cos(angle), std::sin(angle), 0.0);
+
+        // the enclosed mass is radius^2
+        const double speed = std::sqrt(radius);
+        bodies.emplace_back(radius * direction, speed * glm::dvec3(-direction.y, direction.x, 0.0), 1.0f / count, 0.0f);
+    }
+
+    toCenterOfMassFrame(bodies);
+    return bodies;
+}
+
+// Plummer sphere with scale radius 1 in virial equilibrium, sampled as in Aarseth, Henon and Wielen (1974)
+inline Bodies plummer(int count, double mass, std::mt19937_64& random) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    Bodies bodies;
+    bodies.reserve(count);
+
+    while (static_cast<int>(bodies.size()) < count) {
+        const double radius = 1.0 / std::sqrt(std::pow(uniform(random), -2.0 / 3.0) - 1.0);
+        // the far tail only slows the tree down
+        if (!(radius < 10.0)) {
+            continue;
+        }
+
+        // rejection sampling of q = v / v_escape with density q^2 (1 - q^2)^(7/2)
+        double q = 0;
+        while (true) {
+            q = uniform(random);
+            if (0.1 * uniform(random) < q * q * std::pow(1.0 - q * q, 3.5)) {
+                break;
+            }
+        }
+
+        const double escapeSpeed = std::sqrt(2.0 * mass) * std::pow(1.0 + radius * radius, -0.25);
+        bodies.emplace_back(isotropic(radius, random), isotropic(q * escapeSpeed, random), static_cast<float>(mass / count), 0.0f);
+    }
+
+    toCenterOfMassFrame(bodies);
+    return bodies;
+}
+
+// Cold disk of half the mass around a central binary of the other half. The binary is closer than the softening
+// length and orbits far faster than the disk, so the block time steps of the binary and the inner disk are shorter
+// than the step size while the outer disk keeps the full step.
+inline Bodies binaryInDisk(int count, double softening, std::mt19937_64& random) {
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    Bodies bodies;
+    bodies.reserve(count);
+
+    const int diskCount = std::max(count - 2, 0);
+    for (int i = 0; i < diskCount; i++) {
+        const double radius = std::sqrt(uniform(random));
+        const double angle = 2.0 * glm::pi<double>() * uniform(random);
+        const glm::dvec3 direction(std::cos(angle), std::sin(angle), 0.0);
+
+        // the binary acts as a point mass of 0.5 on the disk
+        const double speed = std::sqrt((0.5 + 0.5 * radius * radius) / radius);
+        bodies.emplace_back(radius * direction, speed * glm::dvec3(-direction.y, direction.x, 0.0), 0.5f / diskCount, 0.0f);
+    }
+
+    // circular orbit in the softened potential of the partner
+    const double separation = 0.04;
+    const double acceleration = 0.25 * separation / std::pow(separation * separation + softening * softening, 1.5);
+    const double speed = std::sqrt(acceleration * separation / 2.0);
+    bodies.emplace_back(glm::dvec3(separation / 2.0, 0.0, 0.0), glm::dvec3(0.0, speed, 0.0), 0.25f, 0.0f);
+    bodies.emplace_back(glm::dvec3(-separation / 2.0, 0.0, 0.0), glm::dvec3(0.0, -speed, 0.0), 0.25f, 0.0f);
+
+    toCenterOfMassFrame(bodies);
+    return bodies;
+}
+
+// two Plummer spheres on a bound, almost head on orbit
+inline Bodies twoGalaxies(int count, std::mt19937_64& random) {
+    Bodies bodies = plummer(count / 2, 0.5, random);
+    Bodies second = plummer(count - count / 2, 0.5, random);
+
+    for (auto& body : bodies) {
+        body.position += glm::dvec3(-3.0, -0.5, 0.0);
+        body.velocity += glm::dvec3(0.2, 0.0, 0.0);
+    }
+    for (auto& body : second) {
+        body.position += glm::dvec3(3.0, 0.5, 0.0);
+        body.velocity += glm::dvec3(-0.2, 0.0, 0.0);
+    }
+
+    bodies.insert(bodies.end(), second.begin(), second.end());
+    toCenterOfMassFrame(bodies);
+    return bodies;
+}
+
+// the softening of the force engines, only used to place the binary on a circular orbit
+inline Bodies createScenario(const std::string& name, int count, double softening, unsigned long long seed) {
+    std::mt19937_64 random(seed);
+
+    if (name == "disk") {
+        return uniformDisk(count, random);
+    }
+    if (name == "plummer") {
+        return plummer(count, 1.0, random);
+    }
+    if (name == "galaxies") {
+        return twoGalaxies(count, random);
+    }
+    if (name == "binary") {
+        return binaryInDisk(count, softening, random);
+    }
+
+    throw std::runtime_error("Unknown scenario " + name);
+}
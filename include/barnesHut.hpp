@@ -0,0 +1,261 @@
+#pragma once
+#include "state.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+// quadtree for dim == 2, octree for dim == 3
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class BarnesHut {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using TVec = State::TVec;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    static constexpr int childCount = 1 << dim;
+
+  private:
+    struct Node {
+        TVec center;
+        TValue halfSize;
+
+        TVec centerOfMass;
+        TValue mass;
+
+        // range inside the permuted body index array
+        int begin, end;
+        int firstChild = -1;
+
+        inline bool isLeaf() const {
+            return firstChild < 0;
+        }
+    };
+
+    TValue G;
+    TValue theta;
+    TValue softening;
+
+    int leafSize;
+    int maxDepth;
+
+    std::vector<Node> nodes;
+    std::vector<int> indices;
+    std::vector<int> scratch;
+
+    // traversal stack per thread
+    std::vector<std::vector<int>> stacks;
+
+    inline int childIndex(const TVec& center, const TVec& position) const {
+        int index = 0;
+        for (int d = 0; d < dim; d++) {
+            if (position[d] >= center[d]) {
+                index |= 1 << d;
+            }
+        }
+
+        return index;
+    }
+
+    inline void buildNode(int nodeIndex, const State& state, int depth) {
+        Node& node = nodes[nodeIndex];
+
+        node.mass = 0;
+        node.centerOfMass = TVec(0);
+        for (int k = node.begin; k < node.end; k++) {
+            node.mass += state.masses[indices[k]];
+            node.centerOfMass += state.masses[indices[k]] * state.position(indices[k]);
+        }
+
+        if (node.mass > 0) {
+            node.centerOfMass /= node.mass;
+        }
+        else {
+            node.centerOfMass = node.center;
+        }
+
+        if (node.end - node.begin <= leafSize || depth >= maxDepth) {
+            return;
+        }
+
+        // counting sort of the node's bodies into its children
+        std::array<int, childCount + 1> offsets{};
+        for (int k = node.begin; k < node.end; k++) {
+            offsets[childIndex(node.center, state.position(indices[k])) + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        std::array<int, childCount> cursor;
+        std::copy(offsets.begin(), offsets.end() - 1, cursor.begin());
+        for (int k = node.begin; k < node.end; k++) {
+            scratch[node.begin + cursor[childIndex(node.center, state.position(indices[k]))]++] = indices[k];
+        }
+        std::copy(scratch.begin() + node.begin, scratch.begin() + node.end, indices.begin() + node.begin);
+
+        const TVec center = node.center;
+        const TValue childHalfSize = node.halfSize / static_cast<TValue>(2);
+        const int begin = node.begin;
+        const int firstChild = static_cast<int>(nodes.size());
+        node.firstChild = firstChild;
+
+        // node is invalidated from here on
+        for (int c = 0; c < childCount; c++) {
+            Node child;
+            child.center = center;
+            for (int d = 0; d < dim; d++) {
+                child.center[d] += (c & (1 << d)) ? childHalfSize : -childHalfSize;
+            }
+            child.halfSize = childHalfSize;
+            child.begin = begin + offsets[c];
+            child.end = begin + offsets[c + 1];
+
+            nodes.push_back(child);
+        }
+
+        for (int c = 0; c < childCount; c++) {
+            if (nodes[firstChild + c].end > nodes[firstChild + c].begin) {
+                buildNode(firstChild + c, state, depth + 1);
+            }
+        }
+    }
+
+    inline bool contains(const Node& node, const TVec& position) const {
+        for (int d = 0; d < dim; d++) {
+            if (std::abs(position[d] - node.center[d]) > node.halfSize) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    inline TVec pairAcceleration(const TVec& position, const TVec& source, TValue mass) const {
+        const TVec& distanceVec = source - position;
+        const TValue distanceSquared = glm::dot(distanceVec, distanceVec) + softening * softening;
+        const TValue inverseDistance = static_cast<TValue>(1) / glm::sqrt(distanceSquared);
+
+        return G * mass * inverseDistance * inverseDistance * inverseDistance * distanceVec;
+    }
+
+  public:
+    inline BarnesHut(TValue G, TValue theta = static_cast<TValue>(0.5), TValue softening = static_cast<TValue>(0), int leafSize = 1, int maxDepth = 32)
+        : G(G), theta(theta), softening(softening), leafSize(leafSize), maxDepth(maxDepth) {
+    }
+
+    inline TValue getTheta() const {
+        return theta;
+    }
+
+    inline void setTheta(TValue theta) {
+        this->theta = theta;
+    }
+
+    inline void build(const State& state) {
+        nodes.clear();
+        indices.resize(state.size());
+        scratch.resize(state.size());
+        std::iota(indices.begin(), indices.end(), 0);
+
+        if (state.empty()) {
+            return;
+        }
+
+        TVec min = state.position(0);
+        TVec max = state.position(0);
+        for (int i = 1; i < state.size(); i++) {
+            min = glm::min(min, state.position(i));
+            max = glm::max(max, state.position(i));
+        }
+
+        Node root;
+        root.center = (min + max) / static_cast<TValue>(2);
+        root.halfSize = 0;
+        for (int d = 0; d < dim; d++) {
+            root.halfSize = std::max(root.halfSize, (max[d] - min[d]) / static_cast<TValue>(2));
+        }
+        // keep bodies on the upper boundary strictly inside the root cell
+        root.halfSize = root.halfSize * static_cast<TValue>(1.0001) + std::numeric_limits<TValue>::min();
+        root.begin = 0;
+        root.end = state.size();
+
+        nodes.push_back(root);
+        buildNode(0, state, 0);
+    }
+
+    // the depth first traversal holds at most the children of one node per level, so the stacks never grow past
+    // their reserved size
+    inline void reserveStacks(int threadCount) {
+        stacks.resize(threadCount);
+        for (std::vector<int>& stack : stacks) {
+            stack.reserve(static_cast<std::size_t>(maxDepth + 1) << dim);
+        }
+    }
+
+    inline TVec acceleration(int index, const State& state, std::vector<int>& stack) const {
+        const TVec& position = state.position(index);
+        const TValue thetaSquared = theta * theta;
+        TVec acceleration = TVec(0);
+
+        stack.clear();
+        stack.push_back(0);
+        while (!stack.empty()) {
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (node.isLeaf()) {
+                for (int k = node.begin; k < node.end; k++) {
+                    if (indices[k] != index) {
+                        acceleration += pairAcceleration(position, state.position(indices[k]), state.masses[indices[k]]);
+                    }
+                }
+
+                continue;
+            }
+
+            // a cell that contains the body is always opened, otherwise the body could act on itself through the
+            // center of mass for large theta
+            const TVec& distanceVec = node.centerOfMass - position;
+            const TValue size = static_cast<TValue>(2) * node.halfSize;
+            if (!contains(node, position) && size * size < thetaSquared * glm::dot(distanceVec, distanceVec)) {
+                acceleration += pairAcceleration(position, node.centerOfMass, node.mass);
+                continue;
+            }
+
+            for (int c = 0; c < childCount; c++) {
+                if (nodes[node.firstChild + c].end > nodes[node.firstChild + c].begin) {
+                    stack.push_back(node.firstChild + c);
+                }
+            }
+        }
+
+        return acceleration;
+    }
+
+    // builds the tree once and evaluates the accelerations of all bodies
+    inline void operator()(const State& state, Accelerations& accelerations, ThreadPool& threadPool) {
+        build(state);
+
+        assign<dim, TValue>(accelerations, state.size());
+        reserveStacks(threadPool.getThreadCount());
+        threadPool.parallelFor(0, state.size(), [&](int begin, int end, int thread) {
+            for (int i = begin; i < end; i++) {
+                scatter<dim, TValue>(accelerations, i, acceleration(i, state, stacks[thread]));
+            }
+        }, 64);
+    }
+
+    inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) {
+        build(state);
+
+        reserveStacks(threadPool.getThreadCount());
+        threadPool.parallelFor(0, static_cast<int>(targets.size()), [&](int begin, int end, int thread) {
+            for (int k = begin; k < end; k++) {
+                scatter<dim, TValue>(accelerations, targets[k], acceleration(targets[k], state, stacks[thread]));
+            }
+        }, 64);
+    }
+};
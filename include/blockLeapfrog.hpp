@@ -0,0 +1,208 @@
+#pragma once
+#include "bytes.hpp"
+#include "integrators.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// Hierarchical kick drift kick leapfrog with individual power of two time steps. Each body has a level k and
+// advances with stepSize / 2^k, only the bodies that finish their block step get new accelerations. All bodies
+// are synchronized at the end of every step. By default the time step of a body is accuracy * |a| / |da/dt|, which
+// only depends on the time scale of its own acceleration, so the levels follow the dynamics in any units.
+template<int dim, typename TValue, typename T>
+class BlockLeapfrog {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    enum Criterion {
+        ACCELERATION,
+        JERK
+    };
+
+  private:
+    TValue accuracy = static_cast<TValue>(0.025);
+    TValue softening = static_cast<TValue>(1);
+    int maxLevel = 8;
+    Criterion criterion = JERK;
+
+    std::vector<int> levels;
+    std::vector<int> active;
+    Accelerations previousAccelerations;
+
+    inline int period(int level) const {
+        return 1 << (maxLevel - level);
+    }
+
+    inline TValue timeStep(int index, const Accelerations& accelerations, TValue previousTimeStep, TValue stepSize) const {
+        TValue acceleration = 0;
+        TValue jerk = 0;
+        for (int d = 0; d < dim; d++) {
+            acceleration += accelerations[d][index] * accelerations[d][index];
+
+            const TValue difference = accelerations[d][index] - previousAccelerations[d][index];
+            jerk += difference * difference;
+        }
+        acceleration = std::sqrt(acceleration);
+
+        if (criterion == JERK && previousTimeStep > 0) {
+            jerk = std::sqrt(jerk) / previousTimeStep;
+
+            return jerk > 0 ? accuracy * acceleration / jerk : stepSize;
+        }
+
+        return acceleration > 0 ? std::sqrt(static_cast<TValue>(2) * accuracy * softening / acceleration) : stepSize;
+    }
+
+    // The jerk of the first step is estimated from the accelerations after drifting all bodies by one tick, the
+    // state is restored bitwise afterwards. Costs one additional force evaluation whenever the levels are reset.
+    template<typename TEvaluate>
+    inline void probeJerk(State& state, TValue tick, const TEvaluate& evaluate, ThreadPool& threadPool) {
+        const VectorColumns<dim, TValue> positions = state.positions;
+
+        addScaled<dim, TValue>(state.positions, state.velocities, tick, threadPool);
+        evaluate(state, previousAccelerations);
+
+        state.positions = positions;
+    }
+
+    // smallest level whose step does not exceed the desired one and whose block starts at tick
+    inline int chooseLevel(TValue desiredTimeStep, TValue stepSize, int tick) const {
+        int level = 0;
+        while (level < maxLevel && stepSize / static_cast<TValue>(1 << level) > desiredTimeStep) {
+            level++;
+        }
+
+        while (level < maxLevel && tick % period(level) != 0) {
+            level++;
+        }
+
+        return level;
+    }
+
+  public:
+    inline void setAccuracy(TValue accuracy) {
+        this->accuracy = accuracy;
+    }
+
+    inline void setSoftening(TValue softening) {
+        this->softening = softening;
+    }
+
+    inline void setMaxLevel(int maxLevel) {
+        this->maxLevel = maxLevel;
+        reset();
+    }
+
+    inline void setCriterion(Criterion criterion) {
+        this->criterion = criterion;
+    }
+
+    inline const std::vector<int>& getLevels() const {
+        return levels;
+    }
+
+    // forget the levels, e.g. after bodies were merged
+    inline void reset() {
+        levels.clear();
+    }
+
+    // the settings, levels and previous accelerations, used by the checkpoints of the simulation
+    inline void save(std::vector<char>& buffer) const {
+        appendValue(buffer, accuracy);
+        appendValue(buffer, softening);
+        appendValue(buffer, maxLevel);
+        appendValue(buffer, criterion);
+
+        appendVector(buffer, levels);
+        for (int d = 0; d < dim; d++) {
+            appendVector(buffer, previousAccelerations[d]);
+        }
+    }
+
+    inline void load(ByteReader& reader) {
+        accuracy = reader.read<TValue>();
+        softening = reader.read<TValue>();
+        maxLevel = reader.read<int>();
+        criterion = reader.read<Criterion>();
+
+        reader.readVector(levels);
+        for (int d = 0; d < dim; d++) {
+            reader.readVector(previousAccelerations[d]);
+        }
+    }
+
+    template<typename TEvaluate>
+    inline void step(State& state, Accelerations& accelerations, TValue stepSize, const TEvaluate& evaluate, ThreadPool& threadPool) {
+        const int count = state.size();
+        const int tickCount = 1 << maxLevel;
+        const TValue tick = stepSize / static_cast<TValue>(tickCount);
+
+        if (static_cast<int>(levels.size()) != count) {
+            levels.resize(count);
+            previousAccelerations = accelerations;
+
+            TValue probeStep = 0;
+            if (criterion == JERK) {
+                probeStep = tick;
+                probeJerk(state, probeStep, evaluate, threadPool);
+            }
+
+            for (int i = 0; i < count; i++) {
+                levels[i] = chooseLevel(timeStep(i, accelerations, probeStep, stepSize), stepSize, 0);
+            }
+        }
+
+        int time = 0;
+        while (time < tickCount) {
+            // opening half kick of the bodies that start a block step
+            threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+                for (int i = begin; i < end; i++) {
+                    if (time % period(levels[i]) == 0) {
+                        const TValue halfStep = period(levels[i]) * tick / static_cast<TValue>(2);
+                        for (int d = 0; d < dim; d++) {
+                            state.velocities[d][i] += accelerations[d][i] * halfStep;
+                        }
+                    }
+                }
+            });
+
+            int next = tickCount;
+            for (int i = 0; i < count; i++) {
+                next = std::min(next, (time / period(levels[i]) + 1) * period(levels[i]));
+            }
+
+            addScaled<dim, TValue>(state.positions, state.velocities, (next - time) * tick, threadPool);
+            time = next;
+
+            active.clear();
+            for (int i = 0; i < count; i++) {
+                if (time % period(levels[i]) == 0) {
+                    active.push_back(i);
+                }
+            }
+
+            for (int i : active) {
+                for (int d = 0; d < dim; d++) {
+                    previousAccelerations[d][i] = accelerations[d][i];
+                }
+            }
+
+            evaluate(state, active, accelerations);
+
+            // closing half kick and new levels of the active bodies
+            threadPool.parallelFor(0, static_cast<int>(active.size()), [&](int begin, int end, int) {
+                for (int k = begin; k < end; k++) {
+                    const int i = active[k];
+                    const TValue blockStep = period(levels[i]) * tick;
+
+                    for (int d = 0; d < dim; d++) {
+                        state.velocities[d][i] += accelerations[d][i] * blockStep / static_cast<TValue>(2);
+                    }
+
+                    levels[i] = chooseLevel(timeStep(i, accelerations, blockStep, stepSize), stepSize, time);
+                }
+            });
+        }
+    }
+};
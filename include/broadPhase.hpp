@@ -0,0 +1,179 @@
+#pragma once
+#include "state.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+// Finds the pairs of bodies whose bounding spheres overlap, so the exact collision test only runs on them.
+template<int dim, typename TValue>
+class BroadPhase {
+  public:
+    enum Method {
+        SPATIAL_HASH,
+        SWEEP_AND_PRUNE
+    };
+
+  private:
+    using Cell = std::array<std::int64_t, dim>;
+
+    Method method = SPATIAL_HASH;
+
+    std::vector<Cell> cells;
+    std::vector<std::uint32_t> buckets;
+    std::vector<int> bucketStart;
+    std::vector<int> bucketItems;
+
+    // the order of the last sweep is almost sorted for the next one
+    std::vector<int> order;
+    std::vector<int> active;
+
+    static inline bool overlap(const VectorColumns<dim, TValue>& positions, const Column<TValue>& radii, int i, int j) {
+        TValue distance = 0;
+        for (int d = 0; d < dim; d++) {
+            const TValue difference = positions[d][i] - positions[d][j];
+            distance += difference * difference;
+        }
+
+        const TValue radius = radii[i] + radii[j];
+        return distance <= radius * radius;
+    }
+
+    static inline std::uint32_t hash(const Cell& cell, std::uint32_t mask) {
+        static constexpr std::uint64_t primes[] = {0x9E3779B185EBCA87ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull};
+
+        std::uint64_t result = 0;
+        for (int d = 0; d < dim; d++) {
+            result ^= static_cast<std::uint64_t>(cell[d]) * primes[d % 3];
+        }
+
+        return static_cast<std::uint32_t>((result ^ (result >> 29)) & mask);
+    }
+
+    inline void spatialHash(const VectorColumns<dim, TValue>& positions, const Column<TValue>& radii, std::vector<std::pair<int, int>>& pairs) {
+        const int count = static_cast<int>(radii.size());
+
+        // bodies closer than the sum of their radii lie in neighbouring cells
+        TValue cellSize = 2 * *std::max_element(radii.begin(), radii.end());
+        if (!(cellSize > 0)) {
+            cellSize = 1;
+        }
+
+        const std::uint32_t bucketCount = std::bit_ceil(static_cast<std::uint32_t>(2 * count));
+        const std::uint32_t mask = bucketCount - 1;
+
+        cells.resize(count);
+        buckets.resize(count);
+        bucketStart.assign(bucketCount + 1, 0);
+        bucketItems.resize(count);
+
+        for (int i = 0; i < count; i++) {
+            for (int d = 0; d < dim; d++) {
+                cells[i][d] = static_cast<std::int64_t>(std::floor(positions[d][i] / cellSize));
+            }
+
+            buckets[i] = hash(cells[i], mask);
+            bucketStart[buckets[i] + 1]++;
+        }
+
+        std::partial_sum(bucketStart.begin(), bucketStart.end(), bucketStart.begin());
+        for (int i = 0; i < count; i++) {
+            bucketItems[bucketStart[buckets[i]]++] = i;
+        }
+        // the counting sort moved every start to the end of its bucket
+        std::rotate(bucketStart.begin(), bucketStart.end() - 1, bucketStart.end());
+        bucketStart[0] = 0;
+
+        int offsetCount = 1;
+        for (int d = 0; d < dim; d++) {
+            offsetCount *= 3;
+        }
+
+        for (int i = 0; i < count; i++) {
+            for (int offset = 0; offset < offsetCount; offset++) {
+                Cell neighbour = cells[i];
+                for (int d = 0, rest = offset; d < dim; d++, rest /= 3) {
+                    neighbour[d] += rest % 3 - 1;
+                }
+
+                const std::uint32_t bucket = hash(neighbour, mask);
+                for (int k = bucketStart[bucket]; k < bucketStart[bucket + 1]; k++) {
+                    const int j = bucketItems[k];
+
+                    // different cells may share a bucket, every j matches exactly one neighbour
+                    if (j < i && cells[j] == neighbour && overlap(positions, radii, i, j)) {
+                        pairs.emplace_back(i, j);
+                    }
+                }
+            }
+        }
+    }
+
+    inline void sweepAndPrune(const VectorColumns<dim, TValue>& positions, const Column<TValue>& radii, std::vector<std::pair<int, int>>& pairs) {
+        const int count = static_cast<int>(radii.size());
+        const Column<TValue>& x = positions[0];
+
+        const auto lower = [&](int i) {
+            return x[i] - radii[i];
+        };
+
+        if (static_cast<int>(order.size()) != count) {
+            order.resize(count);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](int i, int j) { return lower(i) < lower(j); });
+        }
+        else {
+            // insertion sort is linear for the small movements of one step
+            for (int k = 1; k < count; k++) {
+                const int i = order[k];
+                int l = k;
+                while (l > 0 && lower(order[l - 1]) > lower(i)) {
+                    order[l] = order[l - 1];
+                    l--;
+                }
+                order[l] = i;
+            }
+        }
+
+        active.clear();
+        for (int i : order) {
+            std::erase_if(active, [&](int j) { return x[j] + radii[j] < lower(i); });
+
+            for (int j : active) {
+                if (overlap(positions, radii, i, j)) {
+                    pairs.emplace_back(std::max(i, j), std::min(i, j));
+                }
+            }
+
+            active.push_back(i);
+        }
+    }
+
+  public:
+    inline void setMethod(Method method) {
+        this->method = method;
+    }
+
+    inline Method getMethod() const {
+        return method;
+    }
+
+    // appends the pairs (i, j) with j < i whose bounding spheres overlap
+    inline void findPairs(const VectorColumns<dim, TValue>& positions, const Column<TValue>& radii, std::vector<std::pair<int, int>>& pairs) {
+        if (radii.empty()) {
+            return;
+        }
+
+        if (method == SPATIAL_HASH) {
+            spatialHash(positions, radii, pairs);
+        }
+        else {
+            sweepAndPrune(positions, radii, pairs);
+        }
+    }
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+template<typename TValue>
+inline void appendBytes(std::vector<char>& buffer, const TValue* values, std::size_t count) {
+    // the data of an empty column may be null, which memcpy does not accept even for zero bytes
+    if (count == 0) {
+        return;
+    }
+
+    const std::size_t offset = buffer.size();
+    buffer.resize(offset + count * sizeof(TValue));
+    std::memcpy(buffer.data() + offset, values, count * sizeof(TValue));
+}
+
+template<typename TValue>
+inline void appendValue(std::vector<char>& buffer, const TValue& value) {
+    appendBytes(buffer, &value, 1);
+}
+
+// the size followed by the values
+template<typename TVector>
+inline void appendVector(std::vector<char>& buffer, const TVector& values) {
+    appendValue(buffer, static_cast<std::uint64_t>(values.size()));
+    appendBytes(buffer, values.data(), values.size());
+}
+
+// reads what the append functions wrote, running past the end throws
+class ByteReader {
+  private:
+    const char* data;
+    std::size_t size;
+    std::size_t offset = 0;
+
+  public:
+    inline ByteReader(const char* data, std::size_t size)
+        : data(data), size(size) {
+    }
+
+    template<typename TValue>
+    inline void read(TValue* values, std::size_t count) {
+        if (count > (size - offset) / sizeof(TValue)) {
+            throw std::runtime_error("Unexpected end of data");
+        }
+        if (count == 0) {
+            return;
+        }
+
+        std::memcpy(values, data + offset, count * sizeof(TValue));
+        offset += count * sizeof(TValue);
+    }
+
+    template<typename TValue>
+    inline TValue read() {
+        TValue value;
+        read(&value, 1);
+        return value;
+    }
+
+    template<typename TVector>
+    inline void readVector(TVector& values) {
+        const std::uint64_t count = read<std::uint64_t>();
+        if (count > (size - offset) / sizeof(typename TVector::value_type)) {
+            throw std::runtime_error("Unexpected end of data");
+        }
+
+        values.resize(count);
+        read(values.data(), count);
+    }
+
+    // the next count bytes without copying them
+    inline const char* skip(std::size_t count) {
+        if (count > size - offset) {
+            throw std::runtime_error("Unexpected end of data");
+        }
+
+        const char* result = data + offset;
+        offset += count;
+        return result;
+    }
+
+    inline bool atEnd() const {
+        return offset == size;
+    }
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include "bytes.hpp"
+#include "state.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// File layout: CheckpointHeader followed by the fields of the simulation in the order Simulation::saveCheckpoint
+// appends them. Checkpoints are only meant to be read on the same platform by the same build.
+struct CheckpointHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dim;
+    std::uint32_t valueSize;
+    std::uint32_t attributeSize;
+};
+
+inline constexpr char checkpointMagic[8] = {'G', 'R', 'A', 'V', 'C', 'K', 'P', 'T'};
+inline constexpr std::uint32_t checkpointVersion = 4;
+
+template<int dim, typename TValue>
+inline void appendColumns(std::vector<char>& buffer, const VectorColumns<dim, TValue>& columns) {
+    for (int d = 0; d < dim; d++) {
+        appendVector(buffer, columns[d]);
+    }
+}
+
+template<int dim, typename TValue>
+inline void readColumns(ByteReader& reader, VectorColumns<dim, TValue>& columns) {
+    for (int d = 0; d < dim; d++) {
+        reader.readVector(columns[d]);
+    }
+}
+
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+inline void appendState(std::vector<char>& buffer, const SoAState<dim, TValue, T>& state) {
+    static_assert(std::is_trivially_copyable_v<T>, "The attributes are stored as raw bytes");
+
+    appendColumns<dim, TValue>(buffer, state.positions);
+    appendColumns<dim, TValue>(buffer, state.velocities);
+    appendVector(buffer, state.masses);
+    appendVector(buffer, state.radii);
+    appendVector(buffer, state.ids);
+    appendVector(buffer, state.attributes);
+}
+
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+inline void readState(ByteReader& reader, SoAState<dim, TValue, T>& state) {
+    readColumns<dim, TValue>(reader, state.positions);
+    readColumns<dim, TValue>(reader, state.velocities);
+    reader.readVector(state.masses);
+    reader.readVector(state.radii);
+    reader.readVector(state.ids);
+    reader.readVector(state.attributes);
+
+    for (int d = 0; d < dim; d++) {
+        if (state.positions[d].size() != state.ids.size() || state.velocities[d].size() != state.ids.size()) {
+            throw std::runtime_error("Corrupt state in checkpoint");
+        }
+    }
+    if (state.masses.size() != state.ids.size() || state.radii.size() != state.ids.size() || state.attributes.size() != state.ids.size()) {
+        throw std::runtime_error("Corrupt state in checkpoint");
+    }
+
+    state.rebuildIndices();
+}
+
+// Writes checkpoints on a background thread. Every checkpoint is written to a temporary file that replaces the
+// target once it is complete, so a crash never leaves a partial checkpoint behind. A checkpoint that was not
+// started yet is replaced by a newer one.
+class CheckpointWriter {
+  private:
+    std::thread writer;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable drained;
+    std::optional<std::pair<std::string, std::vector<char>>> pending = std::nullopt;
+    bool writing = false;
+    bool stop = false;
+    std::string error;
+
+    void writerLoop();
+    void writeFile(const std::string& path, const std::vector<char>& buffer);
+
+    // throws the error of the last failed checkpoint
+    void checkError();
+
+  public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void write(const std::string& path, std::vector<char>&& buffer);
+
+    // blocks until the last checkpoint is written
+    void flush();
+};
@@ -0,0 +1,164 @@
+#pragma once
+#include "forceLaw.hpp"
+#include "state.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <concepts>
+#include <vector>
+
+// symmetric direct summation, each pair is evaluated once
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T, ForceLaw<TValue> TForceLaw = SoftenedNewtonian<TValue>>
+class DirectSum {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+  private:
+    // tile rows of the deterministic sum are spread over this many buffers regardless of the thread count
+    static constexpr int deterministicPartitionCount = 16;
+
+    TForceLaw law;
+
+    // bodies per tile, a tile of positions, masses and accelerations should fit into L1
+    int tileSize;
+
+    // per thread or per partition accumulation buffers of the symmetric parallel path
+    std::vector<Accelerations> buffers;
+
+    inline void interact(int i, int j, const State& state, Accelerations& accelerations) const {
+        TValue distance[dim];
+        TValue distanceSquared = 0;
+        for (int d = 0; d < dim; d++) {
+            distance[d] = state.positions[d][j] - state.positions[d][i];
+            distanceSquared += distance[d] * distance[d];
+        }
+
+        const TValue force = law(distanceSquared);
+
+        for (int d = 0; d < dim; d++) {
+            accelerations[d][i] += state.masses[j] * force * distance[d];
+            accelerations[d][j] -= state.masses[i] * force * distance[d];
+        }
+    }
+
+    // all interactions of the tile row starting at iBegin with the tiles left of the diagonal
+    inline void interactTileRow(int iBegin, const State& state, Accelerations& accelerations) const {
+        const int count = state.size();
+        const int iEnd = std::min(iBegin + tileSize, count);
+
+        // off diagonal tiles
+        for (int jBegin = 0; jBegin < iBegin; jBegin += tileSize) {
+            const int jEnd = std::min(jBegin + tileSize, count);
+
+            for (int i = iBegin; i < iEnd; i++) {
+                for (int j = jBegin; j < jEnd; j++) {
+                    interact(i, j, state, accelerations);
+                }
+            }
+        }
+
+        // diagonal tile
+        for (int i = iBegin; i < iEnd; i++) {
+            for (int j = iBegin; j < i; j++) {
+                interact(i, j, state, accelerations);
+            }
+        }
+    }
+
+    // full sum for body i in a fixed order, independent of the partitioning
+    inline void accumulate(int i, const State& state, Accelerations& accelerations) const {
+        TValue acceleration[dim] = {};
+
+        for (int j = 0; j < state.size(); j++) {
+            if (j == i) {
+                continue;
+            }
+
+            TValue distance[dim];
+            TValue distanceSquared = 0;
+            for (int d = 0; d < dim; d++) {
+                distance[d] = state.positions[d][j] - state.positions[d][i];
+                distanceSquared += distance[d] * distance[d];
+            }
+
+            const TValue force = law(distanceSquared);
+            for (int d = 0; d < dim; d++) {
+                acceleration[d] += state.masses[j] * force * distance[d];
+            }
+        }
+
+        for (int d = 0; d < dim; d++) {
+            accelerations[d][i] = acceleration[d];
+        }
+    }
+
+  public:
+    inline DirectSum(TValue G, TValue softening = static_cast<TValue>(0), int tileSize = 256)
+        requires std::constructible_from<TForceLaw, TValue, TValue>
+        : law(G, softening), tileSize(tileSize) {
+    }
+
+    inline explicit DirectSum(const TForceLaw& law, int tileSize = 256)
+        : law(law), tileSize(tileSize) {
+    }
+
+    inline void operator()(const State& state, Accelerations& accelerations, ThreadPool& threadPool) {
+        const int count = state.size();
+        const int threadCount = threadPool.getThreadCount();
+
+        const int rowCount = (count + tileSize - 1) / tileSize;
+
+        assign<dim, TValue>(accelerations, count);
+
+        // the symmetric sum depends on the order of the tiles, a deterministic pool assigns the rows to a fixed number
+        // of partitions instead of the threads that happen to pick them up
+        const int partitionCount = threadPool.isDeterministic() ? std::min(deterministicPartitionCount, rowCount) : threadCount;
+        if (partitionCount <= 1) {
+            for (int iBegin = 0; iBegin < count; iBegin += tileSize) {
+                interactTileRow(iBegin, state, accelerations);
+            }
+
+            return;
+        }
+
+        buffers.resize(partitionCount);
+        for (auto& buffer : buffers) {
+            assign<dim, TValue>(buffer, count);
+        }
+
+        if (threadPool.isDeterministic()) {
+            // interleaved rows keep the partitions about equally expensive
+            threadPool.run(partitionCount, [&](int partition, int) {
+                for (int row = partition; row < rowCount; row += partitionCount) {
+                    interactTileRow(row * tileSize, state, buffers[partition]);
+                }
+            });
+        }
+        else {
+            // longest rows first
+            threadPool.run(rowCount, [&](int row, int thread) {
+                interactTileRow((rowCount - 1 - row) * tileSize, state, buffers[thread]);
+            });
+        }
+
+        // the buffers are added in a fixed order
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            for (const auto& buffer : buffers) {
+                for (int d = 0; d < dim; d++) {
+                    for (int i = begin; i < end; i++) {
+                        accelerations[d][i] += buffer[d][i];
+                    }
+                }
+            }
+        });
+    }
+
+    inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) const {
+        threadPool.parallelFor(0, static_cast<int>(targets.size()), [&](int begin, int end, int) {
+            for (int k = begin; k < end; k++) {
+                accumulate(targets[k], state, accelerations);
+            }
+        }, 64);
+    }
+};
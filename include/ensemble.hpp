@@ -0,0 +1,200 @@
+#pragma once
+#include "simulation.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Advances many independent simulations, e.g. the variants of a parameter sweep, in lockstep on one thread pool.
+// Small members are stepped as a whole on a single thread each, so the threads take member after member and stay
+// busy even if every member only has a few hundred bodies. Members with at least parallelThreshold bodies use the
+// whole pool for their force evaluations instead, one after another.
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T, template<int, typename, typename> typename TIntegrator = VelocityVerlet,
+         ForceLawPolicy<TValue> TForceLaw = DynamicForceLaw, MergeRulePolicy<dim, TValue, T> TMergeRule = DynamicMergeRule>
+class Ensemble {
+  public:
+    using Member = Simulation<dim, TValue, T, TIntegrator, TForceLaw, TMergeRule>;
+
+    struct Summary {
+        int count = 0;
+        double mean = 0;
+        double standardDeviation = 0;
+        double minimum = 0;
+        double median = 0;
+        double maximum = 0;
+    };
+
+    int parallelThreshold = 4096;
+
+  private:
+    struct Slot {
+        std::unique_ptr<Member> simulation;
+        // single threaded, runs inline on the thread that steps the member
+        std::shared_ptr<ThreadPool> threadPool;
+    };
+
+    std::shared_ptr<ThreadPool> threadPool;
+    std::vector<Slot> members;
+
+    // reused by every advance, so stepping does not allocate once they are sized
+    std::vector<int> large;
+    std::vector<std::pair<double, int>> small;
+    std::vector<int> order;
+    mutable std::vector<std::exception_ptr> errors;
+
+    inline int bodyCount(const Slot& member) const {
+        return member.simulation->getState(member.simulation->endTime()).size();
+    }
+
+    // calls task(member) for the given members on the pool, exceptions must not leave the worker threads
+    template<typename TTask>
+    inline void forEach(const std::vector<int>& indices, const TTask& task) const {
+        errors.assign(indices.size(), nullptr);
+
+        threadPool->run(static_cast<int>(indices.size()), [&](int i, int) {
+            try {
+                task(indices[i]);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+
+        for (const std::exception_ptr& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+  public:
+    inline Ensemble(const std::shared_ptr<ThreadPool>& threadPool = std::make_shared<ThreadPool>())
+        : threadPool(threadPool) {
+    }
+
+    // takes over the simulation, its thread pool is replaced
+    inline int add(std::unique_ptr<Member> simulation) {
+        // a deterministic member gives the same results on one thread as on the whole pool
+        Slot member = {std::move(simulation), std::make_shared<ThreadPool>(1, threadPool->isDeterministic())};
+        member.simulation->setThreadPool(member.threadPool);
+
+        members.push_back(std::move(member));
+        return size() - 1;
+    }
+
+    // constructs a member from the arguments of a Simulation constructor
+    template<typename... TArgs>
+    inline int emplace(TArgs&&... args) {
+        return add(std::make_unique<Member>(std::forward<TArgs>(args)...));
+    }
+
+    inline int size() const {
+        return static_cast<int>(members.size());
+    }
+
+    inline Member& getMember(int index) {
+        return *members[index].simulation;
+    }
+
+    inline const Member& getMember(int index) const {
+        return *members[index].simulation;
+    }
+
+    inline ThreadPool& getThreadPool() const {
+        return *threadPool;
+    }
+
+    // advances every member by the given number of steps
+    inline void advance(int steps = 1) {
+        large.clear();
+        small.clear();
+
+        for (int i = 0; i < size(); i++) {
+            const int bodies = bodyCount(members[i]);
+            if (bodies >= parallelThreshold && threadPool->getThreadCount() > 1) {
+                large.push_back(i);
+            }
+            else {
+                small.emplace_back(static_cast<double>(bodies) * bodies, i);
+            }
+        }
+
+        for (int index : large) {
+            Member& simulation = *members[index].simulation;
+
+            simulation.setThreadPool(threadPool);
+            try {
+                for (int step = 0; step < steps; step++) {
+                    simulation.step();
+                }
+            }
+            catch (...) {
+                simulation.setThreadPool(members[index].threadPool);
+                throw;
+            }
+            simulation.setThreadPool(members[index].threadPool);
+        }
+
+        // the most expensive members first, the cheap ones fill the gaps at the end
+        std::sort(small.begin(), small.end(), [](const auto& first, const auto& second) { return first.first > second.first; });
+
+        order.resize(small.size());
+        for (std::size_t i = 0; i < small.size(); i++) {
+            order[i] = small[i].second;
+        }
+
+        forEach(order, [&](int index) {
+            for (int step = 0; step < steps; step++) {
+                members[index].simulation->step();
+            }
+        });
+    }
+
+    // one value per member, computed in parallel
+    inline std::vector<double> evaluate(const std::function<double(const Member&)>& result) const {
+        std::vector<int> indices(size());
+        for (int i = 0; i < size(); i++) {
+            indices[i] = i;
+        }
+
+        std::vector<double> values(size());
+        forEach(indices, [&](int index) {
+            values[index] = result(*members[index].simulation);
+        });
+
+        return values;
+    }
+
+    static inline Summary summarize(std::vector<double> values) {
+        Summary summary;
+        summary.count = static_cast<int>(values.size());
+        if (values.empty()) {
+            return summary;
+        }
+
+        std::sort(values.begin(), values.end());
+        summary.minimum = values.front();
+        summary.maximum = values.back();
+
+        const std::size_t middle = values.size() / 2;
+        summary.median = values.size() % 2 == 1 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+
+        for (double value : values) {
+            summary.mean += value;
+        }
+        summary.mean /= summary.count;
+
+        double variance = 0;
+        for (double value : values) {
+            variance += (value - summary.mean) * (value - summary.mean);
+        }
+        summary.standardDeviation = summary.count > 1 ? std::sqrt(variance / (summary.count - 1)) : 0;
+
+        return summary;
+    }
+};
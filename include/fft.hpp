@@ -0,0 +1,176 @@
+#pragma once
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <complex>
+#include <numbers>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// iterative radix 2 FFT of a fixed power of two size, the transforms are not normalized
+template<typename TValue>
+class FFT {
+  public:
+    using Complex = std::complex<TValue>;
+
+  private:
+    int size = 0;
+    std::vector<Complex> twiddles;
+    std::vector<Complex> inverseTwiddles;
+    std::vector<int> reversed;
+
+    // lines transformed together along the strided axes, so every gathered cache line is used completely
+    static constexpr int blockSize = 16;
+
+    // a block of lines of the grid per thread
+    std::vector<std::vector<Complex>> lines;
+
+    // std::complex multiplies with checks for infinities
+    static inline Complex multiply(const Complex& first, const Complex& second) {
+        return Complex(first.real() * second.real() - first.imag() * second.imag(), first.real() * second.imag() + first.imag() * second.real());
+    }
+
+  public:
+    inline FFT(int size = 0)
+        : size(size), twiddles(size / 2), inverseTwiddles(size / 2), reversed(size) {
+        if (size < 0 || !std::has_single_bit(static_cast<unsigned int>(std::max(size, 1)))) {
+            throw std::runtime_error("The FFT size has to be a power of two");
+        }
+
+        for (int k = 0; k < size / 2; k++) {
+            const double angle = -2.0 * std::numbers::pi * k / size;
+            twiddles[k] = Complex(static_cast<TValue>(std::cos(angle)), static_cast<TValue>(std::sin(angle)));
+            inverseTwiddles[k] = std::conj(twiddles[k]);
+        }
+
+        const int bits = std::countr_zero(static_cast<unsigned int>(std::max(size, 1)));
+        for (int i = 0; i < size; i++) {
+            int result = 0;
+            for (int b = 0; b < bits; b++) {
+                result |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            reversed[i] = result;
+        }
+    }
+
+    inline int getSize() const {
+        return size;
+    }
+
+    inline void transform(Complex* data, bool inverse) const {
+        for (int i = 0; i < size; i++) {
+            if (i < reversed[i]) {
+                std::swap(data[i], data[reversed[i]]);
+            }
+        }
+
+        const Complex* factors = inverse ? inverseTwiddles.data() : twiddles.data();
+        for (int length = 2; length <= size; length *= 2) {
+            const int half = length / 2;
+            const int step = size / length;
+
+            for (int begin = 0; begin < size; begin += length) {
+                for (int k = 0; k < half; k++) {
+                    const Complex product = multiply(factors[k * step], data[begin + k + half]);
+
+                    data[begin + k + half] = data[begin + k] - product;
+                    data[begin + k] += product;
+                }
+            }
+        }
+    }
+
+    // transforms count interleaved lines at once, value i of line b is data[i * count + b]
+    inline void transformLines(Complex* data, int count, bool inverse) const {
+        for (int i = 0; i < size; i++) {
+            if (i < reversed[i]) {
+                std::swap_ranges(data + i * count, data + (i + 1) * count, data + reversed[i] * count);
+            }
+        }
+
+        const Complex* factors = inverse ? inverseTwiddles.data() : twiddles.data();
+        for (int length = 2; length <= size; length *= 2) {
+            const int half = length / 2;
+            const int step = size / length;
+
+            for (int begin = 0; begin < size; begin += length) {
+                for (int k = 0; k < half; k++) {
+                    const Complex factor = factors[k * step];
+                    Complex* low = data + (begin + k) * count;
+                    Complex* high = data + (begin + k + half) * count;
+
+                    for (int b = 0; b < count; b++) {
+                        const Complex product = multiply(factor, high[b]);
+
+                        high[b] = low[b] - product;
+                        low[b] += product;
+                    }
+                }
+            }
+        }
+    }
+
+    // Transforms a grid of size^dim values along every axis, the first axis is stored contiguously. Only the
+    // first used values along each axis are non zero before a forward transform and only those are needed after an
+    // inverse one, lines that are zero or not needed are skipped.
+    template<int dim>
+    inline void transformGrid(Complex* grid, bool inverse, ThreadPool& threadPool, int used) {
+        int lineCount = 1;
+        for (int d = 1; d < dim; d++) {
+            lineCount *= size;
+        }
+
+        // the strides are multiples of size, so a block never crosses the end of a stride
+        const int block = std::min(blockSize, size);
+
+        lines.resize(threadPool.getThreadCount());
+        for (auto& line : lines) {
+            line.resize(block * size);
+        }
+
+        for (int step = 0; step < dim; step++) {
+            const int axis = inverse ? dim - 1 - step : step;
+
+            int stride = 1;
+            for (int d = 0; d < axis; d++) {
+                stride *= size;
+            }
+
+            const int linesPerTask = stride == 1 ? 1 : block;
+            threadPool.parallelFor(0, lineCount / linesPerTask, [&](int begin, int end, int thread) {
+                Complex* line = lines[thread].data();
+
+                for (int task = begin; task < end; task++) {
+                    const int l = task * linesPerTask;
+
+                    // the axes after this one are either still zero or not needed
+                    bool skip = false;
+                    for (int high = l / stride; high > 0; high /= size) {
+                        skip |= high % size >= used;
+                    }
+                    if (skip) {
+                        continue;
+                    }
+
+                    Complex* first = grid + (l / stride) * stride * size + l % stride;
+                    if (stride == 1) {
+                        transform(first, inverse);
+                        continue;
+                    }
+
+                    // consecutive lines are adjacent in memory along the strided axis
+                    for (int i = 0; i < size; i++) {
+                        std::copy_n(first + i * stride, block, line + i * block);
+                    }
+                    transformLines(line, block, inverse);
+                    for (int i = 0; i < size; i++) {
+                        std::copy_n(line + i * block, block, first + i * stride);
+                    }
+                }
+            }, stride == 1 ? 8 : 1);
+        }
+    }
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include <cmath>
+#include <concepts>
+
+#include <glm/glm.hpp>
+
+// A body of mass m at the offset d from another body accelerates it by m * law(|d|^2) * d. The laws are
+// inlined into the pair loop of DirectSum, so their parameters are known to the compiler there.
+template<typename TLaw, typename TValue>
+concept ForceLaw = std::copy_constructible<TLaw> && requires(const TLaw& law, TValue distanceSquared) {
+    { law(distanceSquared) } -> std::convertible_to<TValue>;
+};
+
+// selects the std::function callbacks of the Simulation instead of a force law
+struct DynamicForceLaw {
+};
+
+template<typename TLaw, typename TValue>
+concept ForceLawPolicy = std::same_as<TLaw, DynamicForceLaw> || ForceLaw<TLaw, TValue>;
+
+template<typename TValue>
+struct Newtonian {
+    TValue G;
+
+    inline constexpr explicit Newtonian(TValue G)
+        : G(G) {
+    }
+
+    inline TValue operator()(TValue distanceSquared) const {
+        const TValue inverseDistance = static_cast<TValue>(1) / glm::sqrt(distanceSquared);
+        return G * inverseDistance * inverseDistance * inverseDistance;
+    }
+};
+
+// Plummer softening, keeps close encounters finite
+template<typename TValue>
+struct SoftenedNewtonian {
+    TValue G;
+    TValue softeningSquared;
+
+    inline constexpr explicit SoftenedNewtonian(TValue G, TValue softening = static_cast<TValue>(0))
+        : G(G), softeningSquared(softening * softening) {
+    }
+
+    inline TValue operator()(TValue distanceSquared) const {
+        const TValue inverseDistance = static_cast<TValue>(1) / glm::sqrt(softeningSquared + distanceSquared);
+        return G * inverseDistance * inverseDistance * inverseDistance;
+    }
+};
+
+// gravity screened beyond the range, the potential is -G m exp(-r / range) / r
+template<typename TValue>
+struct Yukawa {
+    TValue G;
+    TValue inverseRange;
+
+    inline constexpr explicit Yukawa(TValue G, TValue range)
+        : G(G), inverseRange(static_cast<TValue>(1) / range) {
+    }
+
+    inline TValue operator()(TValue distanceSquared) const {
+        const TValue distance = glm::sqrt(distanceSquared);
+        const TValue scaled = distance * inverseRange;
+
+        return G * std::exp(-scaled) * (static_cast<TValue>(1) + scaled) / (distanceSquared * distance);
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Lock free queue between one producer and one consumer thread. The slots are reused, so frames of similar size
+// are passed on without allocations once the queue is warm.
+template<typename T>
+class FrameQueue {
+  public:
+    enum Backpressure {
+        // frames pushed while the queue is full are discarded
+        DROP,
+        // the producer waits until the consumer took a frame
+        BLOCK
+    };
+
+  private:
+    std::vector<T> slots;
+    Backpressure backpressure;
+
+    // both indices only increase, the slot is the index modulo the capacity
+    alignas(64) std::atomic<std::size_t> head = 0;
+    alignas(64) std::atomic<std::size_t> tail = 0;
+    alignas(64) std::atomic<bool> closed = false;
+    // changes whenever the consumer takes a frame or the queue is closed, a blocked producer waits on it
+    std::atomic<unsigned int> wakeUps = 0;
+    std::atomic<std::size_t> dropped = 0;
+
+  public:
+    inline FrameQueue(int capacity, Backpressure backpressure)
+        : slots(std::max(capacity, 1)), backpressure(backpressure) {
+    }
+
+    // producer side, returns false if the frame was dropped or the queue is closed
+    inline bool push(const T& value) {
+        const std::size_t position = tail.load(std::memory_order_relaxed);
+        std::size_t consumed = head.load(std::memory_order_acquire);
+
+        while (position - consumed == slots.size()) {
+            if (backpressure == DROP) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            // checked again after reading the counter, so no wake up is missed
+            const unsigned int seen = wakeUps.load(std::memory_order_acquire);
+            if (isClosed()) {
+                return false;
+            }
+
+            consumed = head.load(std::memory_order_acquire);
+            if (position - consumed == slots.size()) {
+                wakeUps.wait(seen, std::memory_order_acquire);
+                consumed = head.load(std::memory_order_acquire);
+            }
+        }
+
+        slots[position % slots.size()] = value;
+        tail.store(position + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // consumer side, swaps the oldest frame into value
+    inline bool tryPop(T& value) {
+        const std::size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        std::swap(value, slots[position % slots.size()]);
+        head.store(position + 1, std::memory_order_release);
+
+        wakeUps.fetch_add(1, std::memory_order_release);
+        wakeUps.notify_one();
+
+        return true;
+    }
+
+    // called by the producer after the last frame or by the consumer to stop the producer
+    inline void close() {
+        closed.store(true, std::memory_order_release);
+
+        wakeUps.fetch_add(1, std::memory_order_release);
+        wakeUps.notify_one();
+    }
+
+    inline bool isClosed() const {
+        return closed.load(std::memory_order_acquire);
+    }
+
+    // closed and all frames were taken
+    inline bool isFinished() const {
+        return isClosed() && head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    inline std::size_t getDropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
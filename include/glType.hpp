@@ -14,14 +14,15 @@ inline int glType<float>() {
     return GL_FLOAT;
 }
 
+// attributes with a divisor advance once per instance instead of once per vertex
 template<int dim, typename T>
-inline void setupVertexAttributes() {
+inline void setupVertexAttributes(unsigned int location = 0, unsigned int divisor = 0) {
     switch (glType<T>()) {
         case GL_DOUBLE:
-            glVertexAttribLPointer(0, dim, glType<T>(), dim * sizeof(T), (void*)0);
+            glVertexAttribLPointer(location, dim, glType<T>(), dim * sizeof(T), (void*)0);
             break;
         default:
-            glVertexAttribPointer(0,
+            glVertexAttribPointer(location,
                                   dim,
                                   glType<T>(),
                                   GL_FALSE,
@@ -30,5 +31,6 @@ inline void setupVertexAttributes() {
             break;
     }
 
-    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(location);
+    glVertexAttribDivisor(location, divisor);
 }
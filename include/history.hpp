@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+struct HistoryPolicy {
+    // every keyframeInterval-th state is stored together with everything needed to continue the integration from it,
+    // 1 keeps every state
+    int keyframeInterval = 64;
+    // number of most recent states that are stored in addition to the keyframes
+    int recentStates = 0;
+    // if positive, every state is also stored compressed with these absolute error bounds and states that are not
+    // stored exactly are decoded instead of integrated again
+    double positionError = 0;
+    double velocityError = 0;
+    // every intraInterval-th compressed state is encoded without reference to the previous one, the others only
+    // store the difference
+    int intraInterval = 64;
+    // keeps the positions and velocities of every body in per body columns for Simulation::getTrajectory
+    bool trajectories = false;
+    // number of most recent steps of which the trajectories are kept, 0 keeps all of them
+    int trajectoryLength = 1024;
+};
+
+template<typename T>
+class RingBuffer {
+  private:
+    std::vector<T> values;
+    std::vector<int> times;
+    int capacity = 0;
+    int next = 0;
+
+  public:
+    inline RingBuffer(int capacity = 0)
+        : capacity(capacity) {
+        values.reserve(capacity);
+        times.reserve(capacity);
+    }
+
+    inline void push(int time, const T& value) {
+        if (capacity == 0) {
+            return;
+        }
+
+        if (static_cast<int>(values.size()) < capacity) {
+            values.push_back(value);
+            times.push_back(time);
+        }
+        else {
+            // reuses the storage of the overwritten value
+            if constexpr (requires { values[next].copyFrom(value); }) {
+                values[next].copyFrom(value);
+            }
+            else {
+                values[next] = value;
+            }
+            times[next] = time;
+        }
+
+        next = (next + 1) % capacity;
+    }
+
+    inline const T* find(int time) const {
+        for (std::size_t i = 0; i < times.size(); i++) {
+            if (times[i] == time) {
+                return &values[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    inline T* find(int time) {
+        return const_cast<T*>(static_cast<const RingBuffer*>(this)->find(time));
+    }
+};
@@ -0,0 +1,295 @@
+#pragma once
+#include "state.hpp"
+#include "threadPool.hpp"
+#include "trajectoryFile.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary layout: InitialConditionsHeader followed by the columns of the positions, the velocities and the
+// attributes with count values each. Masses and radii are taken from the attributes.
+//
+// Text layout: one body per line with the position, the velocity, the mass and the radius, separated by commas or
+// white space. Empty lines and lines starting with # are skipped, a first line that does not start with a number
+// is taken as column names.
+struct InitialConditionsHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dim;
+    std::uint32_t valueSize;
+    std::uint32_t attributeSize;
+    std::uint64_t count;
+};
+
+inline constexpr char initialConditionsMagic[8] = {'G', 'R', 'A', 'V', 'I', 'N', 'I', 'T'};
+inline constexpr std::uint32_t initialConditionsVersion = 1;
+
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class InitialConditions {
+    static_assert(std::is_trivially_copyable_v<T>, "The attributes are stored as raw bytes");
+
+  public:
+    using State = SoAState<dim, TValue, T>;
+
+  private:
+    static constexpr int fieldCount = 2 * dim + 2;
+
+    // chunks per thread, the lines are not equally expensive
+    static constexpr int chunksPerThread = 4;
+
+    static inline bool isSeparator(char c) {
+        return c == ' ' || c == '\t' || c == ',' || c == ';' || c == '\r';
+    }
+
+    static inline const char* lineEnd(const char* begin, const char* end) {
+        const char* result = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        return result != nullptr ? result : end;
+    }
+
+    static inline const char* nextLine(const char* lineEnd, const char* end) {
+        return lineEnd < end ? lineEnd + 1 : end;
+    }
+
+    // the first character of a line that holds a body or nullptr
+    static inline const char* content(const char* begin, const char* end) {
+        while (begin < end && isSeparator(*begin)) {
+            begin++;
+        }
+
+        return begin < end && *begin != '#' ? begin : nullptr;
+    }
+
+    // counts the bodies of the lines in [begin, end)
+    static inline int countBodies(const char* begin, const char* end) {
+        int count = 0;
+        for (const char* line = begin; line < end;) {
+            const char* next = lineEnd(line, end);
+            if (content(line, next) != nullptr) {
+                count++;
+            }
+
+            line = nextLine(next, end);
+        }
+
+        return count;
+    }
+
+    // parses the bodies of the lines in [begin, end) into the state starting at index, returns the position of an
+    // invalid line or nullptr
+    static inline const char* parseBodies(const char* begin, const char* end, State& state, int index) {
+        TValue values[fieldCount];
+
+        for (const char* line = begin; line < end;) {
+            const char* next = lineEnd(line, end);
+            const char* position = content(line, next);
+
+            if (position == nullptr) {
+                line = nextLine(next, end);
+                continue;
+            }
+
+            for (int field = 0; field < fieldCount; field++) {
+                while (position < next && isSeparator(*position)) {
+                    position++;
+                }
+
+                const auto [parsed, error] = std::from_chars(position, next, values[field]);
+                if (error != std::errc()) {
+                    return line;
+                }
+                position = parsed;
+            }
+
+            while (position < next && isSeparator(*position)) {
+                position++;
+            }
+            if (position != next) {
+                return line;
+            }
+
+            for (int d = 0; d < dim; d++) {
+                state.positions[d][index] = values[d];
+                state.velocities[d][index] = values[dim + d];
+            }
+            state.attributes[index] = T{static_cast<float>(values[2 * dim]), static_cast<float>(values[2 * dim + 1])};
+
+            index++;
+            line = nextLine(next, end);
+        }
+
+        return nullptr;
+    }
+
+    static inline std::string lineNumber(const char* data, const char* line) {
+        return std::to_string(std::count(data, line, '\n') + 1);
+    }
+
+  public:
+    static inline bool isBinary(const MappedFile& file) {
+        return file.getSize() >= sizeof(initialConditionsMagic) && std::memcmp(file.getData(), initialConditionsMagic, sizeof(initialConditionsMagic)) == 0;
+    }
+
+    // binary or text file, told apart by the magic of the binary format
+    static inline State load(const std::string& path, ThreadPool& threadPool) {
+        const MappedFile file(path);
+        State state;
+
+        if (isBinary(file)) {
+            loadBinary(file, state, threadPool);
+        }
+        else if constexpr (requires(float mass, float radius) { T{mass, radius}; }) {
+            loadText(file, state, threadPool);
+        }
+        else {
+            throw std::runtime_error("Text initial conditions need attributes made of a mass and a radius");
+        }
+
+        return state;
+    }
+
+    static inline void loadBinary(const MappedFile& file, State& state, ThreadPool& threadPool) {
+        if (file.getSize() < sizeof(InitialConditionsHeader)) {
+            throw std::runtime_error("Initial conditions file is truncated");
+        }
+
+        InitialConditionsHeader header;
+        std::memcpy(&header, file.getData(), sizeof(header));
+
+        if (std::memcmp(header.magic, initialConditionsMagic, sizeof(header.magic)) != 0 || header.version != initialConditionsVersion) {
+            throw std::runtime_error("Not an initial conditions file");
+        }
+        if (header.dim != dim || header.valueSize != sizeof(TValue) || header.attributeSize != sizeof(T)) {
+            throw std::runtime_error("Initial conditions file was written with different simulation parameters");
+        }
+
+        const std::size_t count = header.count;
+        if ((file.getSize() - sizeof(header)) / (2 * dim * sizeof(TValue) + sizeof(T)) < count) {
+            throw std::runtime_error("Initial conditions file is truncated");
+        }
+
+        state.resize(count);
+
+        // the copies fault in the pages of the mapping, several threads keep the disk busy
+        const char* data = file.getData() + sizeof(header);
+        const auto copy = [&](auto* column) {
+            using Value = std::remove_pointer_t<decltype(column)>;
+            const char* source = data;
+
+            threadPool.parallelFor(0, static_cast<int>(count), [&](int begin, int end, int) {
+                std::memcpy(column + begin, source + begin * sizeof(Value), (end - begin) * sizeof(Value));
+            }, 1 << 16);
+
+            data += count * sizeof(Value);
+        };
+
+        for (int d = 0; d < dim; d++) {
+            copy(state.positions[d].data());
+        }
+        for (int d = 0; d < dim; d++) {
+            copy(state.velocities[d].data());
+        }
+        copy(state.attributes.data());
+
+        threadPool.parallelFor(0, static_cast<int>(count), [&](int begin, int end, int) {
+            state.updateDerived(begin, end);
+        }, 1 << 16);
+    }
+
+    // parses chunks of lines in parallel, a first pass counts the bodies of every chunk
+    static inline void loadText(const MappedFile& file, State& state, ThreadPool& threadPool)
+        requires requires(float mass, float radius) { T{mass, radius}; }
+    {
+        const char* data = file.getData();
+        const char* end = data + file.getSize();
+
+        // column names
+        const char* begin = data;
+        while (begin < end) {
+            const char* next = lineEnd(begin, end);
+            const char* first = content(begin, next);
+
+            if (first != nullptr) {
+                TValue value;
+                if (std::from_chars(first, next, value).ec != std::errc()) {
+                    begin = nextLine(next, end);
+                }
+                break;
+            }
+
+            begin = nextLine(next, end);
+        }
+
+        const int chunkCount = std::max(1, static_cast<int>(std::min<std::size_t>((end - begin) / 4096 + 1, threadPool.getThreadCount() * chunksPerThread)));
+        std::vector<const char*> chunks(chunkCount + 1);
+        chunks[0] = begin;
+        chunks[chunkCount] = end;
+        for (int c = 1; c < chunkCount; c++) {
+            const char* position = std::max(begin + (end - begin) * c / chunkCount, chunks[c - 1]);
+            chunks[c] = nextLine(lineEnd(position, end), end);
+        }
+
+        std::vector<int> offsets(chunkCount + 1, 0);
+        threadPool.run(chunkCount, [&](int chunk, int) {
+            offsets[chunk + 1] = countBodies(chunks[chunk], chunks[chunk + 1]);
+        });
+
+        for (int c = 0; c < chunkCount; c++) {
+            offsets[c + 1] += offsets[c];
+        }
+        state.resize(offsets[chunkCount]);
+
+        // exceptions must not leave the worker threads
+        std::vector<const char*> errors(chunkCount, nullptr);
+        threadPool.run(chunkCount, [&](int chunk, int) {
+            errors[chunk] = parseBodies(chunks[chunk], chunks[chunk + 1], state, offsets[chunk]);
+            if (errors[chunk] == nullptr) {
+                state.updateDerived(offsets[chunk], offsets[chunk + 1]);
+            }
+        });
+
+        for (const char* error : errors) {
+            if (error != nullptr) {
+                throw std::runtime_error("Invalid body in line " + lineNumber(data, error) + ", expected " + std::to_string(fieldCount) + " numbers");
+            }
+        }
+    }
+
+    static inline void saveBinary(const std::string& path, const State& state) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+
+        InitialConditionsHeader header;
+        std::memcpy(header.magic, initialConditionsMagic, sizeof(header.magic));
+        header.version = initialConditionsVersion;
+        header.dim = dim;
+        header.valueSize = sizeof(TValue);
+        header.attributeSize = sizeof(T);
+        header.count = state.size();
+
+        const auto write = [&](const auto* values, std::size_t count) {
+            file.write(reinterpret_cast<const char*>(values), count * sizeof(*values));
+        };
+
+        write(&header, 1);
+        for (int d = 0; d < dim; d++) {
+            write(state.positions[d].data(), header.count);
+        }
+        for (int d = 0; d < dim; d++) {
+            write(state.velocities[d].data(), header.count);
+        }
+        write(state.attributes.data(), header.count);
+
+        if (!file) {
+            throw std::runtime_error("Failed to write " + path);
+        }
+    }
+};
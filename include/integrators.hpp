@@ -0,0 +1,174 @@
+#pragma once
+#include "state.hpp"
+#include "threadPool.hpp"
+
+#include <cmath>
+#include <utility>
+
+// target += factor * source
+template<int dim, typename TValue>
+inline void addScaled(VectorColumns<dim, TValue>& target, const VectorColumns<dim, TValue>& source, TValue factor, ThreadPool& threadPool) {
+    threadPool.parallelFor(0, static_cast<int>(target[0].size()), [&](int begin, int end, int) {
+        for (int d = 0; d < dim; d++) {
+            TValue* targetData = target[d].data();
+            const TValue* sourceData = source[d].data();
+
+            for (int i = begin; i < end; i++) {
+                targetData[i] += factor * sourceData[i];
+            }
+        }
+    });
+}
+
+// Integrators advance a state by one step. On entry accelerations holds the accelerations of the
+// current state, on return the ones of the new state, so consecutive steps share the evaluation.
+template<int dim, typename TValue, typename T>
+class VelocityVerlet {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    static constexpr int forceEvaluations = 1;
+
+  private:
+    Accelerations nextAccelerations;
+
+  public:
+    template<typename TEvaluate>
+    inline void step(State& state, Accelerations& accelerations, TValue stepSize, const TEvaluate& evaluate, ThreadPool& threadPool) {
+        threadPool.parallelFor(0, state.size(), [&](int begin, int end, int) {
+            for (int d = 0; d < dim; d++) {
+                TValue* position = state.positions[d].data();
+                const TValue* velocity = state.velocities[d].data();
+                const TValue* acceleration = accelerations[d].data();
+
+                for (int i = begin; i < end; i++) {
+                    position[i] += velocity[i] * stepSize + acceleration[i] * stepSize * stepSize / static_cast<TValue>(2);
+                }
+            }
+        });
+
+        evaluate(state, nextAccelerations);
+
+        threadPool.parallelFor(0, state.size(), [&](int begin, int end, int) {
+            for (int d = 0; d < dim; d++) {
+                TValue* velocity = state.velocities[d].data();
+                const TValue* acceleration = accelerations[d].data();
+                const TValue* nextAcceleration = nextAccelerations[d].data();
+
+                for (int i = begin; i < end; i++) {
+                    velocity[i] += (acceleration[i] + nextAcceleration[i]) * stepSize / static_cast<TValue>(2);
+                }
+            }
+        });
+
+        std::swap(accelerations, nextAccelerations);
+    }
+};
+
+// kick drift kick leapfrog
+template<int dim, typename TValue, typename T>
+class Leapfrog {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    static constexpr int forceEvaluations = 1;
+
+    template<typename TEvaluate>
+    inline void step(State& state, Accelerations& accelerations, TValue stepSize, const TEvaluate& evaluate, ThreadPool& threadPool) {
+        const TValue halfStep = stepSize / static_cast<TValue>(2);
+
+        addScaled<dim, TValue>(state.velocities, accelerations, halfStep, threadPool);
+        addScaled<dim, TValue>(state.positions, state.velocities, stepSize, threadPool);
+
+        evaluate(state, accelerations);
+
+        addScaled<dim, TValue>(state.velocities, accelerations, halfStep, threadPool);
+    }
+};
+
+// classical fourth order Runge-Kutta, the first stage reuses the cached accelerations
+template<int dim, typename TValue, typename T>
+class RungeKutta4 {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    static constexpr int forceEvaluations = 4;
+
+  private:
+    State stage;
+
+    Accelerations stageVelocities[2];
+    Accelerations stageAccelerations[2];
+    Accelerations positionSum;
+    Accelerations velocitySum;
+
+  public:
+    template<typename TEvaluate>
+    inline void step(State& state, Accelerations& accelerations, TValue stepSize, const TEvaluate& evaluate, ThreadPool& threadPool) {
+        const TValue halfStep = stepSize / static_cast<TValue>(2);
+        const TValue stageSteps[] = {halfStep, halfStep, stepSize};
+        const TValue weights[] = {2, 2, 1};
+
+        stage = state;
+        positionSum = state.velocities;
+        velocitySum = accelerations;
+
+        const Accelerations* previousVelocities = &state.velocities;
+        const Accelerations* previousAccelerations = &accelerations;
+        for (int k = 0; k < 3; k++) {
+            Accelerations& velocities = stageVelocities[k % 2];
+            Accelerations& stageAcceleration = stageAccelerations[k % 2];
+
+            stage.positions = state.positions;
+            addScaled<dim, TValue>(stage.positions, *previousVelocities, stageSteps[k], threadPool);
+
+            velocities = state.velocities;
+            addScaled<dim, TValue>(velocities, *previousAccelerations, stageSteps[k], threadPool);
+
+            evaluate(stage, stageAcceleration);
+
+            addScaled<dim, TValue>(positionSum, velocities, weights[k], threadPool);
+            addScaled<dim, TValue>(velocitySum, stageAcceleration, weights[k], threadPool);
+
+            previousVelocities = &velocities;
+            previousAccelerations = &stageAcceleration;
+        }
+
+        addScaled<dim, TValue>(state.positions, positionSum, stepSize / static_cast<TValue>(6), threadPool);
+        addScaled<dim, TValue>(state.velocities, velocitySum, stepSize / static_cast<TValue>(6), threadPool);
+
+        evaluate(state, accelerations);
+    }
+};
+
+// fourth order symplectic integrator by Yoshida, composed of three leapfrog steps
+template<int dim, typename TValue, typename T>
+class Yoshida4 {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    static constexpr int forceEvaluations = 3;
+
+    template<typename TEvaluate>
+    inline void step(State& state, Accelerations& accelerations, TValue stepSize, const TEvaluate& evaluate, ThreadPool& threadPool) {
+        const TValue cubeRoot = std::cbrt(static_cast<TValue>(2));
+        const TValue w1 = static_cast<TValue>(1) / (static_cast<TValue>(2) - cubeRoot);
+        const TValue w0 = -cubeRoot * w1;
+
+        const TValue kicks[] = {w1 / 2, (w0 + w1) / 2, (w0 + w1) / 2, w1 / 2};
+        const TValue drifts[] = {w1, w0, w1};
+
+        for (int k = 0; k < 3; k++) {
+            addScaled<dim, TValue>(state.velocities, accelerations, kicks[k] * stepSize, threadPool);
+            addScaled<dim, TValue>(state.positions, state.velocities, drifts[k] * stepSize, threadPool);
+
+            evaluate(state, accelerations);
+        }
+
+        addScaled<dim, TValue>(state.velocities, accelerations, kicks[3] * stepSize, threadPool);
+    }
+};
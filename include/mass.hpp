@@ -31,6 +31,6 @@ template<int dim, typename TValue>
 inline bool collide(const Object<dim, TValue, Mass>& first, const Object<dim, TValue, Mass>& second) {
     const typename Object<dim, TValue, Mass>::TVec& distance = first.position - second.position;
 
-    float collisionDistance = first.attributes.radius + second.attributes.radius;
-    return glm::dot(distance, distance) <= static_cast<TValue>(collisionDistance);
+    const TValue collisionDistance = static_cast<TValue>(first.attributes.radius) + static_cast<TValue>(second.attributes.radius);
+    return glm::dot(distance, distance) <= collisionDistance * collisionDistance;
 }
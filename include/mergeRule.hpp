@@ -0,0 +1,67 @@
+#pragma once
+#include "state.hpp"
+
+#include <cmath>
+#include <concepts>
+#include <vector>
+
+// Replaces the body at index and the other bodies of its collision group by one object.
+template<typename TRule, int dim, typename TValue, typename T>
+concept MergeRule = std::copy_constructible<TRule> && requires(const TRule& rule, int index, const std::vector<int>& group, const SoAState<dim, TValue, T>& state) {
+    { rule(index, group, state) } -> std::convertible_to<Object<dim, TValue, T>>;
+};
+
+// selects the std::function callback of the Simulation instead of a merge rule
+struct DynamicMergeRule {
+};
+
+template<typename TRule, int dim, typename TValue, typename T>
+concept MergeRulePolicy = std::same_as<TRule, DynamicMergeRule> || MergeRule<TRule, dim, TValue, T>;
+
+// perfectly inelastic merge that conserves mass, momentum and volume
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+    requires requires(float mass, float radius) { T{mass, radius}; }
+struct InelasticMerge {
+    using State = SoAState<dim, TValue, T>;
+    using ObjectType = Object<dim, TValue, T>;
+    using TVec = ObjectType::TVec;
+
+    static inline float volume(float radius) {
+        float result = radius;
+        for (int d = 1; d < dim; d++) {
+            result *= radius;
+        }
+
+        return result;
+    }
+
+    static inline float radius(float volume) {
+        if constexpr (dim == 2) {
+            return std::sqrt(volume);
+        }
+        else if constexpr (dim == 3) {
+            return std::cbrt(volume);
+        }
+        else {
+            return std::pow(volume, 1.0f / dim);
+        }
+    }
+
+    inline ObjectType operator()(int index, const std::vector<int>& group, const State& state) const {
+        float mass = state.attributes[index].mass;
+        float totalVolume = volume(state.attributes[index].radius);
+        TVec position = static_cast<TValue>(mass) * state.position(index);
+        TVec velocity = static_cast<TValue>(mass) * state.velocity(index);
+
+        for (int i : group) {
+            const float memberMass = state.attributes[i].mass;
+
+            mass += memberMass;
+            totalVolume += volume(state.attributes[i].radius);
+            position += static_cast<TValue>(memberMass) * state.position(i);
+            velocity += static_cast<TValue>(memberMass) * state.velocity(i);
+        }
+
+        return ObjectType(position / static_cast<TValue>(mass), velocity / static_cast<TValue>(mass), mass, radius(totalVolume));
+    }
+};
@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+// Compiled with GRAVITY_METRICS=0 the timers and counters are empty and cost nothing, metrics() only returns zeros.
+#ifndef GRAVITY_METRICS
+#define GRAVITY_METRICS 1
+#endif
+
+inline constexpr bool metricsEnabled = GRAVITY_METRICS != 0;
+
+struct Metrics {
+    enum Phase {
+        // calls of the force engine
+        FORCES,
+        // the integrator without its force evaluations
+        INTEGRATION,
+        // broad phase, exact tests and merges
+        COLLISIONS,
+        // keyframes, recent states and compressed snapshots
+        HISTORY,
+        // states restored by getState, including the forces integrated again
+        RECONSTRUCTION,
+        PHASE_COUNT
+    };
+
+    std::array<double, PHASE_COUNT> seconds = {};
+
+    std::uint64_t steps = 0;
+    std::uint64_t forceEvaluations = 0;
+    std::uint64_t partialForceEvaluations = 0;
+    // pairs a direct sum would evaluate, approximations like Barnes-Hut evaluate fewer
+    std::uint64_t pairInteractions = 0;
+    std::uint64_t collisionCandidates = 0;
+    std::uint64_t collisions = 0;
+    std::uint64_t merges = 0;
+    // new storage of the history
+    std::uint64_t bytesAllocated = 0;
+    // states copied into and out of the history
+    std::uint64_t bytesCopied = 0;
+
+    static inline const char* getPhaseName(Phase phase) {
+        switch (phase) {
+            case FORCES:
+                return "forces";
+            case INTEGRATION:
+                return "integration";
+            case COLLISIONS:
+                return "collisions";
+            case HISTORY:
+                return "history";
+            case RECONSTRUCTION:
+                return "reconstruction";
+            default:
+                return "unknown";
+        }
+    }
+
+    inline double getTotalSeconds() const {
+        // reconstruction runs outside of the steps
+        double total = 0;
+        for (int phase = 0; phase < RECONSTRUCTION; phase++) {
+            total += seconds[phase];
+        }
+
+        return total;
+    }
+};
+
+// adds the lifetime of the timer to the given seconds
+template<bool enabled = metricsEnabled>
+class ScopedTimer {
+  private:
+    double& seconds;
+    std::chrono::steady_clock::time_point start;
+
+  public:
+    inline ScopedTimer(double& seconds)
+        : seconds(seconds), start(std::chrono::steady_clock::now()) {
+    }
+
+    inline ~ScopedTimer() {
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+template<>
+class ScopedTimer<false> {
+  public:
+    inline ScopedTimer(double&) {
+    }
+};
+
+// counters compile to nothing if metrics are disabled
+inline void addMetric(std::uint64_t& counter, std::uint64_t value = 1) {
+    if constexpr (metricsEnabled) {
+        counter += value;
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include "simdKernel.hpp"
+#include "state.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// Direct sum with the pair interactions in single precision, which doubles the SIMD width compared to double. The
+// positions are converted relative to the center of the bodies before every evaluation, so float resolves the
+// extent of the system instead of the absolute coordinates. The kernel sums blocks of sources in float and the sums
+// of the blocks are accumulated per body in double, the state and the integration keep the precision of TValue.
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class MixedPrecisionDirectSum {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+  private:
+    // targets per kernel call, their accumulators live on the stack
+    static constexpr int chunkSize = 64;
+
+    TValue G;
+    float softening;
+    InstructionSet instructionSet;
+
+    // sources per float sum
+    int blockSize;
+
+    VectorColumns<dim, float> positions;
+    Column<float> masses;
+
+    inline void convert(const State& state, ThreadPool& threadPool) {
+        const int count = state.size();
+
+        TValue origin[dim] = {};
+        if (count > 0) {
+            for (int d = 0; d < dim; d++) {
+                const auto [minimum, maximum] = std::minmax_element(state.positions[d].begin(), state.positions[d].end());
+                origin[d] = (*minimum + *maximum) / 2;
+            }
+        }
+
+        for (int d = 0; d < dim; d++) {
+            positions[d].resize(count);
+        }
+        masses.resize(count);
+
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            for (int d = 0; d < dim; d++) {
+                for (int i = begin; i < end; i++) {
+                    positions[d][i] = static_cast<float>(state.positions[d][i] - origin[d]);
+                }
+            }
+            for (int i = begin; i < end; i++) {
+                masses[i] = static_cast<float>(state.masses[i]);
+            }
+        }, 4096);
+    }
+
+    // sum over all sources for at most chunkSize targets
+    inline void sumChunk(const float* const* targets, int targetCount, double (&sums)[dim][chunkSize]) const {
+        const int count = static_cast<int>(masses.size());
+
+        float partial[dim][chunkSize];
+        float* partialColumns[dim];
+        for (int d = 0; d < dim; d++) {
+            partialColumns[d] = partial[d];
+            std::fill_n(sums[d], targetCount, 0.0);
+        }
+
+        for (int blockBegin = 0; blockBegin < count; blockBegin += blockSize) {
+            const float* sources[dim];
+            for (int d = 0; d < dim; d++) {
+                sources[d] = positions[d].data() + blockBegin;
+            }
+
+            directSumKernel(dim, 0, targetCount, targets, std::min(blockSize, count - blockBegin), sources, masses.data() + blockBegin, 1.0f, softening, partialColumns, instructionSet);
+
+            for (int d = 0; d < dim; d++) {
+                for (int k = 0; k < targetCount; k++) {
+                    sums[d][k] += partial[d][k];
+                }
+            }
+        }
+    }
+
+  public:
+    inline MixedPrecisionDirectSum(TValue G, TValue softening = static_cast<TValue>(0), InstructionSet instructionSet = detectInstructionSet(), int blockSize = 1024)
+        : G(G), softening(static_cast<float>(softening)), instructionSet(instructionSet), blockSize(blockSize) {
+    }
+
+    inline InstructionSet getInstructionSet() const {
+        return instructionSet;
+    }
+
+    inline void operator()(const State& state, Accelerations& accelerations, ThreadPool& threadPool) {
+        const int count = state.size();
+
+        convert(state, threadPool);
+        for (int d = 0; d < dim; d++) {
+            accelerations[d].resize(count);
+        }
+
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            double sums[dim][chunkSize];
+
+            for (int chunkBegin = begin; chunkBegin < end; chunkBegin += chunkSize) {
+                const int targetCount = std::min(chunkSize, end - chunkBegin);
+
+                const float* targets[dim];
+                for (int d = 0; d < dim; d++) {
+                    targets[d] = positions[d].data() + chunkBegin;
+                }
+
+                sumChunk(targets, targetCount, sums);
+                for (int d = 0; d < dim; d++) {
+                    for (int k = 0; k < targetCount; k++) {
+                        accelerations[d][chunkBegin + k] = static_cast<TValue>(G * sums[d][k]);
+                    }
+                }
+            }
+        }, chunkSize);
+    }
+
+    inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) {
+        convert(state, threadPool);
+
+        threadPool.parallelFor(0, static_cast<int>(targets.size()), [&](int begin, int end, int) {
+            double sums[dim][chunkSize];
+            float targetPositions[dim][chunkSize];
+
+            const float* targetColumns[dim];
+            for (int d = 0; d < dim; d++) {
+                targetColumns[d] = targetPositions[d];
+            }
+
+            for (int chunkBegin = begin; chunkBegin < end; chunkBegin += chunkSize) {
+                const int targetCount = std::min(chunkSize, end - chunkBegin);
+
+                for (int d = 0; d < dim; d++) {
+                    for (int k = 0; k < targetCount; k++) {
+                        targetPositions[d][k] = positions[d][targets[chunkBegin + k]];
+                    }
+                }
+
+                sumChunk(targetColumns, targetCount, sums);
+                for (int d = 0; d < dim; d++) {
+                    for (int k = 0; k < targetCount; k++) {
+                        accelerations[d][targets[chunkBegin + k]] = static_cast<TValue>(G * sums[d][k]);
+                    }
+                }
+            }
+        }, chunkSize);
+    }
+};
@@ -17,13 +17,13 @@ template<typename T, int dim, typename TValue>
 concept ObjectAttributes = Drawable<T, dim, TValue>;
 
 template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
-class Simulation;
+class SoAState;
 
 template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
 struct Object {
   private:
     int id = -1;
-    friend class Simulation<dim, TValue, T>;
+    friend class SoAState<dim, TValue, T>;
 
   public:
     using TVec = glm::vec<dim, TValue>;
@@ -43,14 +43,6 @@ struct Object {
         return id;
     }
 
-    struct Trajectory {
-        int objectID;
-        T attributes;
-
-        std::vector<TVec> positions;
-        std::vector<TVec> velocities;
-    };
-
     inline unsigned int getGeometry(std::vector<TVec>& vertices, std::vector<unsigned int>& indices, unsigned int indexOffset = 0) const {
         return attributes.getGeometry(position, vertices, indices, indexOffset);
     }
@@ -0,0 +1,477 @@
+#pragma once
+#include "fft.hpp"
+#include "state.hpp"
+#include "threadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <numbers>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Particle mesh solver for isolated systems. The masses are deposited on a grid with cloud in cell weights and
+// convolved with the Green's function on a grid of twice the size, so the periodic FFT does not wrap around
+// (Hockney and Eastwood). The accelerations are the finite differences of the potential, interpolated with the same
+// weights. With a positive split the mesh only computes the long range part of an erf split of the potential and
+// pairs closer than the cutoff are summed directly (P3M). The cost hardly depends on the number of bodies, on one
+// thread an evaluation with the default grid takes about 15 ms in 2D and 0.1 s in 3D, which breaks even with the
+// direct sum at a few thousand bodies and with the simd direct sum at about 10^4 bodies in 3D.
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class ParticleMesh {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+    using Complex = std::complex<TValue>;
+
+  private:
+    // free cells between the bodies and the border of the grid, needed by the finite differences
+    static constexpr int margin = 2;
+    // the short range force is cut off at this multiple of the split radius
+    static constexpr TValue cutoffFactor = 5;
+
+    TValue G;
+    TValue softening;
+    // cells per axis of the mass grid
+    int gridSize;
+    // split radius in cells, 0 disables the short range sum
+    TValue split;
+
+    FFT<TValue> fft;
+    std::vector<TValue> masses;
+    std::vector<std::vector<TValue>> threadMasses;
+    std::vector<Complex> potential;
+    Accelerations field;
+
+    // transform of the Green's function, only recomputed if the cell size changes
+    std::vector<TValue> green;
+    TValue greenCellSize = 0;
+
+    TValue origin[dim];
+    TValue cellSize = 0;
+
+    // the field of the last solve is reused by partial evaluations until all bodies were evaluated, i.e. for the
+    // sub steps of one block step
+    bool fieldValid = false;
+    int fieldBodyCount = 0;
+
+    // chaining mesh of the short range sum
+    int chainSize = 0;
+    TValue chainCellSize = 0;
+    std::vector<int> chainCells;
+    std::vector<int> chainStart;
+    std::vector<int> chainItems;
+
+    inline int paddedSize() const {
+        return 2 * gridSize;
+    }
+
+    static inline int power(int base) {
+        int result = 1;
+        for (int d = 0; d < dim; d++) {
+            result *= base;
+        }
+
+        return result;
+    }
+
+    // (erf(x) - 2x / sqrt(pi) exp(-x^2)) / x^3, a series avoids the cancellation for small x
+    static inline TValue longRangeFactor(TValue x) {
+        const TValue sqrtPi = std::sqrt(std::numbers::pi_v<TValue>);
+        const TValue x2 = x * x;
+
+        if (x < static_cast<TValue>(0.05)) {
+            return 4 / (3 * sqrtPi) * (1 - static_cast<TValue>(0.6) * x2 + x2 * x2 * 3 / 14);
+        }
+
+        return (std::erf(x) - 2 * x / sqrtPi * std::exp(-x2)) / (x2 * x);
+    }
+
+    inline TValue greensFunction(TValue distance) const {
+        if (split > 0) {
+            const TValue radius = split * cellSize;
+            if (distance == 0) {
+                return -G / (radius * std::sqrt(std::numbers::pi_v<TValue>));
+            }
+
+            return -G * std::erf(distance / (2 * radius)) / distance;
+        }
+
+        TValue distanceSquared = distance * distance + softening * softening;
+        if (distanceSquared == 0) {
+            // the potential of the own cell only has to be finite
+            distanceSquared = cellSize * cellSize / 4;
+        }
+
+        return -G / std::sqrt(distanceSquared);
+    }
+
+    inline void updateGreensFunction(ThreadPool& threadPool) {
+        if (cellSize == greenCellSize) {
+            return;
+        }
+
+        const int size = paddedSize();
+        const int count = power(size);
+
+        // distances wrap around, the padding holds the negative offsets
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            for (int i = begin; i < end; i++) {
+                TValue distanceSquared = 0;
+                for (int d = 0, rest = i; d < dim; d++, rest /= size) {
+                    const int offset = std::min(rest % size, size - rest % size);
+                    distanceSquared += static_cast<TValue>(offset) * offset;
+                }
+
+                potential[i] = Complex(greensFunction(cellSize * std::sqrt(distanceSquared)), 0);
+            }
+        });
+
+        fft.template transformGrid<dim>(potential.data(), false, threadPool, size);
+
+        // the kernel is even, so its transform is real, the normalization of the inverse transform is included
+        green.resize(count);
+        const TValue normalization = static_cast<TValue>(1) / count;
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            for (int i = begin; i < end; i++) {
+                green[i] = potential[i].real() * normalization;
+            }
+        });
+
+        greenCellSize = cellSize;
+    }
+
+    // cubic cells around the bounding box, the cell size is rounded up to a few values per octave so the Green's
+    // function can be reused while the system changes slowly
+    inline void setupGrid(const State& state) {
+        TValue lower[dim], upper[dim];
+        for (int d = 0; d < dim; d++) {
+            const auto [minimum, maximum] = std::minmax_element(state.positions[d].begin(), state.positions[d].end());
+            lower[d] = *minimum;
+            upper[d] = *maximum;
+        }
+
+        TValue extent = 0;
+        for (int d = 0; d < dim; d++) {
+            extent = std::max(extent, upper[d] - lower[d]);
+        }
+        if (!(extent > 0)) {
+            extent = 1;
+        }
+
+        const TValue minimumCellSize = extent / (gridSize - 2 * margin - 1);
+        cellSize = std::exp2(std::ceil(std::log2(minimumCellSize) * 8) / 8);
+
+        for (int d = 0; d < dim; d++) {
+            origin[d] = lower[d] - margin * cellSize;
+        }
+    }
+
+    // calls f(cell, weight) for the cloud in cell weights of body i
+    template<typename TFunction>
+    inline void forEachCorner(int i, const State& state, const TFunction& f) const {
+        int base = 0;
+        TValue fraction[dim];
+
+        for (int d = 0, stride = 1; d < dim; d++, stride *= gridSize) {
+            const TValue position = (state.positions[d][i] - origin[d]) / cellSize;
+            const int cell = std::clamp(static_cast<int>(std::floor(position)), margin, gridSize - margin - 2);
+
+            base += cell * stride;
+            fraction[d] = std::clamp(position - cell, static_cast<TValue>(0), static_cast<TValue>(1));
+        }
+
+        for (int corner = 0; corner < (1 << dim); corner++) {
+            int cell = base;
+            TValue weight = 1;
+
+            for (int d = 0, stride = 1; d < dim; d++, stride *= gridSize) {
+                if (corner & (1 << d)) {
+                    cell += stride;
+                    weight *= fraction[d];
+                }
+                else {
+                    weight *= 1 - fraction[d];
+                }
+            }
+
+            f(cell, weight);
+        }
+    }
+
+    inline void deposit(const State& state, ThreadPool& threadPool) {
+        const int count = power(gridSize);
+        masses.assign(count, 0);
+
+        // the sum over the thread grids depends on the partitioning
+        if (threadPool.getThreadCount() == 1 || threadPool.isDeterministic()) {
+            for (int i = 0; i < state.size(); i++) {
+                forEachCorner(i, state, [&](int cell, TValue weight) {
+                    masses[cell] += state.masses[i] * weight;
+                });
+            }
+
+            return;
+        }
+
+        threadMasses.resize(threadPool.getThreadCount());
+        for (auto& grid : threadMasses) {
+            grid.assign(count, 0);
+        }
+
+        threadPool.parallelFor(0, state.size(), [&](int begin, int end, int thread) {
+            std::vector<TValue>& grid = threadMasses[thread];
+
+            for (int i = begin; i < end; i++) {
+                forEachCorner(i, state, [&](int cell, TValue weight) {
+                    grid[cell] += state.masses[i] * weight;
+                });
+            }
+        });
+
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            for (const auto& grid : threadMasses) {
+                for (int cell = begin; cell < end; cell++) {
+                    masses[cell] += grid[cell];
+                }
+            }
+        });
+    }
+
+    inline void solve(ThreadPool& threadPool) {
+        const int size = paddedSize();
+        const int count = power(size);
+
+        const int cellCount = power(gridSize);
+
+        // the padding is zero, only the cells of the mass grid are copied
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            std::fill(potential.begin() + begin, potential.begin() + end, Complex(0, 0));
+        }, 4096);
+        threadPool.parallelFor(0, cellCount, [&](int begin, int end, int) {
+            for (int cell = begin; cell < end; cell++) {
+                int padded = 0;
+                for (int d = 0, rest = cell, stride = 1; d < dim; d++, rest /= gridSize, stride *= size) {
+                    padded += rest % gridSize * stride;
+                }
+
+                potential[padded] = Complex(masses[cell], 0);
+            }
+        }, 256);
+
+        fft.template transformGrid<dim>(potential.data(), false, threadPool, gridSize);
+
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            for (int i = begin; i < end; i++) {
+                potential[i] *= green[i];
+            }
+        });
+
+        // the finite differences read one cell beyond the mass grid
+        fft.template transformGrid<dim>(potential.data(), true, threadPool, gridSize + 1);
+
+        // fourth order central differences on the cells used by the interpolation
+        for (int d = 0; d < dim; d++) {
+            field[d].resize(cellCount);
+        }
+
+        threadPool.parallelFor(0, cellCount, [&](int begin, int end, int) {
+            for (int cell = begin; cell < end; cell++) {
+                int padded = 0;
+                bool inside = true;
+                for (int d = 0, rest = cell, stride = 1; d < dim; d++, rest /= gridSize, stride *= size) {
+                    inside &= rest % gridSize >= margin && rest % gridSize <= gridSize - margin;
+                    padded += rest % gridSize * stride;
+                }
+
+                for (int d = 0, stride = 1; d < dim; d++, stride *= size) {
+                    if (!inside) {
+                        field[d][cell] = 0;
+                        continue;
+                    }
+
+                    const TValue near = potential[padded + stride].real() - potential[padded - stride].real();
+                    const TValue far = potential[padded + 2 * stride].real() - potential[padded - 2 * stride].real();
+                    field[d][cell] = -(8 * near - far) / (12 * cellSize);
+                }
+            }
+        }, 256);
+    }
+
+    inline void buildChains(const State& state) {
+        const int count = state.size();
+
+        chainCellSize = cutoffFactor * split * cellSize;
+        chainSize = std::max(1, static_cast<int>(std::ceil(gridSize * cellSize / chainCellSize)));
+
+        chainCells.resize(count);
+        chainStart.assign(power(chainSize) + 1, 0);
+        chainItems.resize(count);
+
+        for (int i = 0; i < count; i++) {
+            int cell = 0;
+            for (int d = 0, stride = 1; d < dim; d++, stride *= chainSize) {
+                const int index = static_cast<int>((state.positions[d][i] - origin[d]) / chainCellSize);
+                cell += std::clamp(index, 0, chainSize - 1) * stride;
+            }
+
+            chainCells[i] = cell;
+            chainStart[cell + 1]++;
+        }
+
+        // counting sort, the bodies of a cell keep their order
+        std::partial_sum(chainStart.begin(), chainStart.end(), chainStart.begin());
+        for (int i = 0; i < count; i++) {
+            chainItems[chainStart[chainCells[i]]++] = i;
+        }
+        std::rotate(chainStart.begin(), chainStart.end() - 1, chainStart.end());
+        chainStart[0] = 0;
+    }
+
+    // the difference between the softened Newtonian force and the long range part of the mesh
+    inline void shortRange(int i, const State& state, TValue acceleration[dim]) const {
+        const TValue radius = split * cellSize;
+        const TValue cutoffSquared = chainCellSize * chainCellSize;
+        const TValue longRangeScale = 1 / (8 * radius * radius * radius);
+
+        int neighbourCount = 1;
+        for (int d = 0; d < dim; d++) {
+            neighbourCount *= 3;
+        }
+
+        for (int offset = 0; offset < neighbourCount; offset++) {
+            int cell = 0;
+            bool inside = true;
+
+            for (int d = 0, rest = offset, stride = 1, home = chainCells[i]; d < dim; d++, rest /= 3, stride *= chainSize, home /= chainSize) {
+                const int index = home % chainSize + rest % 3 - 1;
+                inside &= index >= 0 && index < chainSize;
+                cell += index * stride;
+            }
+
+            if (!inside) {
+                continue;
+            }
+
+            for (int k = chainStart[cell]; k < chainStart[cell + 1]; k++) {
+                const int j = chainItems[k];
+                if (j == i) {
+                    continue;
+                }
+
+                TValue distance[dim];
+                TValue distanceSquared = 0;
+                for (int d = 0; d < dim; d++) {
+                    distance[d] = state.positions[d][j] - state.positions[d][i];
+                    distanceSquared += distance[d] * distance[d];
+                }
+
+                if (distanceSquared >= cutoffSquared) {
+                    continue;
+                }
+
+                const TValue softened = distanceSquared + softening * softening;
+                const TValue newton = softened > 0 ? 1 / (softened * std::sqrt(softened)) : 0;
+                const TValue longRange = longRangeFactor(std::sqrt(distanceSquared) / (2 * radius)) * longRangeScale;
+
+                const TValue force = G * state.masses[j] * (newton - longRange);
+                for (int d = 0; d < dim; d++) {
+                    acceleration[d] += force * distance[d];
+                }
+            }
+        }
+    }
+
+    inline void prepare(const State& state, ThreadPool& threadPool) {
+        setupGrid(state);
+        updateGreensFunction(threadPool);
+        deposit(state, threadPool);
+        solve(threadPool);
+
+        if (split > 0) {
+            buildChains(state);
+        }
+
+        fieldValid = true;
+        fieldBodyCount = state.size();
+    }
+
+    inline void evaluate(int i, const State& state, Accelerations& accelerations) const {
+        TValue acceleration[dim] = {};
+
+        forEachCorner(i, state, [&](int cell, TValue weight) {
+            for (int d = 0; d < dim; d++) {
+                acceleration[d] += weight * field[d][cell];
+            }
+        });
+
+        if (split > 0) {
+            shortRange(i, state, acceleration);
+        }
+
+        for (int d = 0; d < dim; d++) {
+            accelerations[d][i] = acceleration[d];
+        }
+    }
+
+  public:
+    // gridSize is the number of cells per axis of the mass grid and has to be a power of two, the FFT runs on twice
+    // that size. A split of about 1.25 cells enables P3M.
+    inline ParticleMesh(TValue G, int gridSize = dim == 2 ? 256 : 64, TValue softening = static_cast<TValue>(0), TValue split = static_cast<TValue>(0))
+        : G(G), softening(softening), gridSize(gridSize), split(split), fft(2 * gridSize) {
+        if (gridSize < 2 * margin + 2) {
+            throw std::runtime_error("The particle mesh needs at least " + std::to_string(2 * margin + 2) + " cells per axis");
+        }
+
+        potential.resize(power(paddedSize()));
+    }
+
+    inline void operator()(const State& state, Accelerations& accelerations, ThreadPool& threadPool) {
+        assign<dim, TValue>(accelerations, state.size());
+        if (state.empty()) {
+            return;
+        }
+
+        prepare(state, threadPool);
+        fieldValid = false;
+
+        threadPool.parallelFor(0, state.size(), [&](int begin, int end, int) {
+            for (int i = begin; i < end; i++) {
+                evaluate(i, state, accelerations);
+            }
+        }, 64);
+    }
+
+    // The mesh is solved at the first partial evaluation after all bodies were evaluated and its field is
+    // interpolated at the current positions of the targets until all bodies were evaluated again. For the block time
+    // steps this solves the long range forces once per step while the bodies in the sub steps only pay for the
+    // interpolation and the short range sum, which is computed at the current positions. The field lags behind by
+    // less than one step, far less than the time the bodies need to cross a cell.
+    inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) {
+        if (targets.empty()) {
+            return;
+        }
+
+        if (!fieldValid || fieldBodyCount != state.size()) {
+            prepare(state, threadPool);
+        }
+        else if (split > 0) {
+            // the chains of the short range sum have to follow the bodies
+            buildChains(state);
+        }
+
+        threadPool.parallelFor(0, static_cast<int>(targets.size()), [&](int begin, int end, int) {
+            for (int k = begin; k < end; k++) {
+                evaluate(targets[k], state, accelerations);
+            }
+        }, 64);
+
+        // the next step starts with a new solve
+        if (static_cast<int>(targets.size()) == state.size()) {
+            fieldValid = false;
+        }
+    }
+};
@@ -2,6 +2,7 @@
 #include "glType.hpp"
 #include "shaders.hpp"
 #include "simulation.hpp"
+#include "streamingBuffer.hpp"
 #include "window.hpp"
 
 #include <stdexcept>
@@ -10,13 +11,25 @@
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+// Every body is drawn as an instance of one unit circle mesh, only the centers and radii change between frames.
+// They are written straight into a persistently mapped buffer.
 template<int dim, typename TValue>
 class Renderer {
   protected:
+    // center and radius
+    using Instance = glm::vec<dim + 1, TValue>;
+
+    static constexpr unsigned int circleVertices = 16;
+
     Window* window;
     unsigned int shaderProgram;
     unsigned int vbo, vao, ebo;
-    unsigned int drawCount;
+    unsigned int indexCount;
+
+    StreamingBuffer instances;
+    unsigned int instanceCount = 0;
+    // first instance of the current region
+    unsigned int baseInstance = 0;
 
     inline void setupShaders() {
         const char* vertexSource = getVertexShader<dim, TValue>();
@@ -81,13 +94,40 @@ class Renderer {
         glGenBuffers(1, &vbo);
         glGenBuffers(1, &ebo);
 
+        std::vector<glm::vec2> vertices = {glm::vec2(0.0f)};
+        std::vector<unsigned int> indices;
+
+        const float anglePerVertex = 2.0f * glm::pi<float>() / circleVertices;
+        for (unsigned int i = 0; i < circleVertices; i++) {
+            vertices.push_back(glm::vec2(glm::cos(anglePerVertex * i), glm::sin(anglePerVertex * i)));
+
+            indices.push_back(0);
+            indices.push_back(i + 1);
+            indices.push_back((i + 1) % circleVertices + 1);
+        }
+        indexCount = indices.size();
+
         bindBuffers();
 
-        setupVertexAttributes<dim, TValue>();
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec2) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+        setupVertexAttributes<2, float>(0);
 
         unbindBuffers();
     }
 
+    inline void reserveInstances(unsigned int count) {
+        if (!instances.reserve(count * sizeof(Instance))) {
+            return;
+        }
+
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instances.getBuffer());
+        setupVertexAttributes<dim + 1, TValue>(1, 1);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
   public:
     inline Renderer(Window* window)
         : window(window) {
@@ -103,7 +143,7 @@ class Renderer {
         // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     }
 
-    inline void draw() const {
+    inline void draw() {
         int width = window->getWidth();
         int height = window->getHeight();
         const glm::mat<4, 4, TValue> projection = glm::ortho<TValue>(-width / 2, width / 2, -height / 2, height / 2);
@@ -119,7 +159,11 @@ class Renderer {
 
         uploadMatrix(shaderProgram, "projection", projection);
 
-        glDrawElements(GL_TRIANGLES, drawCount, GL_UNSIGNED_INT, 0);
+        // the base instance selects the region of the streaming buffer
+        if (instanceCount > 0) {
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instanceCount, baseInstance);
+            instances.fence();
+        }
         glBindVertexArray(0);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
@@ -128,25 +172,18 @@ class Renderer {
     }
 
     template<ObjectAttributes<dim, TValue> T>
-    inline void updateBuffers(const std::vector<Object<dim, TValue, T>>& state) {
-        std::vector<glm::vec<dim, TValue>> vertices;
-        std::vector<unsigned int> indices;
-        unsigned int indexOffset = 0;
-
-        for (const auto& object : state) {
-            indexOffset += object.getGeometry(vertices, indices, indexOffset);
+    inline void updateBuffers(const SoAState<dim, TValue, T>& state) {
+        reserveInstances(state.size());
+
+        Instance* data = static_cast<Instance*>(instances.next());
+        for (int i = 0; i < state.size(); i++) {
+            for (int d = 0; d < dim; d++) {
+                data[i][d] = state.positions[d][i];
+            }
+            data[i][dim] = state.radii[i];
         }
 
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(typename Object<dim, TValue, T>::TVec) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_DYNAMIC_DRAW);
-        drawCount = indices.size();
-
-        glBindVertexArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        instanceCount = state.size();
+        baseInstance = instances.getRegion() * (instances.getRegionSize() / sizeof(Instance));
     }
 };
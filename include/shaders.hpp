@@ -7,27 +7,30 @@
 template<int dim, typename TValue>
 constexpr const char* getVertexShader();
 
+// vertex is a point of the unit circle, instance holds the center and the radius of a body
 template<>
 inline constexpr const char* getVertexShader<2, float>() {
     return "#version 450\n"
-           "layout(location = 0) in vec2 position;\n"
+           "layout(location = 0) in vec2 vertex;\n"
+           "layout(location = 1) in vec3 instance;\n"
 
            "uniform mat4 projection;"
 
            "void main() {\n"
-           "   gl_Position = projection * vec4(position, 0.0, 1.0);\n"
+           "   gl_Position = projection * vec4(instance.xy + instance.z * vertex, 0.0, 1.0);\n"
            "}\0";
 }
 
 template<>
 inline constexpr const char* getVertexShader<2, double>() {
     return "#version 450\n"
-           "layout(location = 0) in dvec2 position;\n"
+           "layout(location = 0) in vec2 vertex;\n"
+           "layout(location = 1) in dvec3 instance;\n"
 
            "uniform dmat4 projection;"
 
            "void main() {\n"
-           "   gl_Position = vec4(projection * dvec4(position, 0.0, 1.0));\n"
+           "   gl_Position = vec4(projection * dvec4(instance.xy + instance.z * dvec2(vertex), 0.0, 1.0));\n"
            "}\0";
 }
 
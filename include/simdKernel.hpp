@@ -0,0 +1,77 @@
+#pragma once
+#include "state.hpp"
+#include "threadPool.hpp"
+
+enum InstructionSet {
+    SCALAR,
+    AVX2,
+    AVX512
+};
+
+InstructionSet detectInstructionSet();
+const char* getInstructionSetName(InstructionSet instructionSet);
+
+// accelerations[d][i] = sum over j of G * m_j * (x_j - x_i) / (|x_j - x_i|^2 + softening^2)^(3/2) for begin <= i < end
+void directSumKernel(int dim, int begin, int end, int count, const float* const* positions, const float* masses, float G, float softening, float* const* accelerations, InstructionSet instructionSet);
+void directSumKernel(int dim, int begin, int end, int count, const double* const* positions, const double* masses, double G, double softening, double* const* accelerations, InstructionSet instructionSet);
+
+// the same sum for the targets begin <= i < end, which are stored apart from the count sources, sources at the
+// position of a target are skipped
+void directSumKernel(int dim, int begin, int end, const float* const* targets, int count, const float* const* positions, const float* masses, float G, float softening, float* const* accelerations, InstructionSet instructionSet);
+void directSumKernel(int dim, int begin, int end, const double* const* targets, int count, const double* const* positions, const double* masses, double G, double softening, double* const* accelerations, InstructionSet instructionSet);
+
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class SimdDirectSum {
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+  private:
+    TValue G;
+    TValue softening;
+
+    InstructionSet instructionSet;
+
+  public:
+    inline SimdDirectSum(TValue G, TValue softening = static_cast<TValue>(0), InstructionSet instructionSet = detectInstructionSet())
+        : G(G), softening(softening), instructionSet(instructionSet) {
+    }
+
+    inline InstructionSet getInstructionSet() const {
+        return instructionSet;
+    }
+
+    inline void operator()(const State& state, Accelerations& accelerations, ThreadPool& threadPool) const {
+        const int count = state.size();
+
+        const TValue* positions[dim];
+        TValue* result[dim];
+        for (int d = 0; d < dim; d++) {
+            accelerations[d].resize(count);
+
+            positions[d] = state.positions[d].data();
+            result[d] = accelerations[d].data();
+        }
+
+        threadPool.parallelFor(0, count, [&](int begin, int end, int) {
+            directSumKernel(dim, begin, end, count, positions, state.masses.data(), G, softening, result, instructionSet);
+        }, 64);
+    }
+
+    inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) const {
+        const int count = state.size();
+
+        const TValue* positions[dim];
+        TValue* result[dim];
+        for (int d = 0; d < dim; d++) {
+            positions[d] = state.positions[d].data();
+            result[d] = accelerations[d].data();
+        }
+
+        threadPool.parallelFor(0, static_cast<int>(targets.size()), [&](int begin, int end, int) {
+            for (int k = begin; k < end; k++) {
+                directSumKernel(dim, targets[k], targets[k] + 1, count, positions, state.masses.data(), G, softening, result, instructionSet);
+            }
+        }, 64);
+    }
+};
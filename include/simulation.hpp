@@ -1,128 +1,699 @@
 #pragma once
+#include "broadPhase.hpp"
+#include "checkpoint.hpp"
+#include "directSum.hpp"
+#include "forceLaw.hpp"
+#include "history.hpp"
+#include "integrators.hpp"
+#include "mergeRule.hpp"
+#include "metrics.hpp"
 #include "object.hpp"
+#include "snapshotCodec.hpp"
+#include "state.hpp"
+#include "threadPool.hpp"
+#include "trajectoryTable.hpp"
+#include "unionFind.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
-#include <set>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 
-template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+// With a ForceLaw the forces are the direct sum of that law and with a MergeRule collisions are merged by that rule,
+// both are called without the indirection of a std::function. The default DynamicForceLaw and DynamicMergeRule take
+// the callbacks of the constructors instead, which can be any force engine chosen at run time.
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T, template<int, typename, typename> typename TIntegrator = VelocityVerlet,
+         ForceLawPolicy<TValue> TForceLaw = DynamicForceLaw, MergeRulePolicy<dim, TValue, T> TMergeRule = DynamicMergeRule>
 class Simulation {
-  private:
-    int objectID = 0;
-
   public:
     using Object = Object<dim, TValue, T>;
 
-    using State = std::vector<Object>;
-    using Trajectory = Object::Trajectory;
+    using State = SoAState<dim, TValue, T>;
     using TVec = Object::TVec;
+    using Accelerations = VectorColumns<dim, TValue>;
+
+    using CollisionCallback = std::function<Object(int, const std::vector<int>&, const State&)>;
+    using ForceCallback = std::function<TVec(int, const State&)>;
+    using AccelerationCallback = std::function<void(const State&, Accelerations&, ThreadPool&)>;
+    // only writes the accelerations of the given bodies
+    using PartialAccelerationCallback = std::function<void(const State&, const std::vector<int>&, Accelerations&, ThreadPool&)>;
+    using Integrator = TIntegrator<dim, TValue, T>;
+    using Codec = SnapshotCodec<dim, TValue, T>;
+    using TrajectoryView = TrajectoryTable<dim, TValue>::View;
+
+    static constexpr bool dynamicForces = std::same_as<TForceLaw, DynamicForceLaw>;
+    static constexpr bool dynamicMerges = std::same_as<TMergeRule, DynamicMergeRule>;
 
-    using CollisionCallback = std::function<Object(int, const std::vector<int>&, const std::vector<Object>&)>;
-    using ForceCallback = std::function<TVec(int, const std::vector<Object>&)>;
+  private:
+    // only instantiated for force laws
+    template<typename TLaw>
+    struct LawEngine {
+        using type = DirectSum<dim, TValue, T, TLaw>;
+    };
+
+  public:
+    using ForceEngine = std::conditional_t<dynamicForces, std::type_identity<AccelerationCallback>, LawEngine<TForceLaw>>::type;
+    using MergeFunction = std::conditional_t<dynamicMerges, CollisionCallback, TMergeRule>;
+
+    // everything needed to continue the integration from a state
+    struct Keyframe {
+        State state;
+        Accelerations accelerations;
+        bool accelerationsValid = false;
+        Integrator integrator;
+        int objectID = 0;
+    };
 
-    std::vector<State> states;
     TValue stepSize;
 
-    inline Simulation(const State& initialState, const ForceCallback& a, float stepSize = 1.0f)
-        : states({initialState}), a(a), stepSize(stepSize) {
-        for (auto& object : states.front()) {
-            object.id = objectID++;
-        }
+    // large initial states should be moved in, they are not copied then
+    inline Simulation(State initialState, const AccelerationCallback& a, float stepSize = 1.0f)
+        requires dynamicForces
+        : a(a), stepSize(stepSize) {
+        initialize(std::move(initialState));
     }
 
-    inline Simulation(const State& initialState, const ForceCallback& a, const CollisionCallback& onCollision, float stepSize = 1.0f)
-        : Simulation(initialState, a, stepSize) {
+    inline Simulation(State initialState, const AccelerationCallback& a, const MergeFunction& onCollision, float stepSize = 1.0f)
+        requires dynamicForces
+        : Simulation(std::move(initialState), a, stepSize) {
         this->onCollision = onCollision;
         handleCollisions = true;
     }
 
+    inline Simulation(State initialState, const ForceCallback& a, float stepSize = 1.0f)
+        requires dynamicForces
+        : Simulation(std::move(initialState), perObject(a), stepSize) {
+        partialA = perObjectPartial(a);
+    }
+
+    inline Simulation(State initialState, const ForceCallback& a, const MergeFunction& onCollision, float stepSize = 1.0f)
+        requires dynamicForces
+        : Simulation(std::move(initialState), perObject(a), onCollision, stepSize) {
+        partialA = perObjectPartial(a);
+    }
+
+    inline Simulation(State initialState, const TForceLaw& law, float stepSize = 1.0f)
+        requires(!dynamicForces)
+        : a(law), stepSize(stepSize) {
+        initialize(std::move(initialState));
+    }
+
+    inline Simulation(State initialState, const TForceLaw& law, const MergeFunction& onCollision, float stepSize = 1.0f)
+        requires(!dynamicForces)
+        : Simulation(std::move(initialState), law, stepSize) {
+        this->onCollision = onCollision;
+        handleCollisions = true;
+    }
+
+    static inline AccelerationCallback perObject(const ForceCallback& a) {
+        return [a](const State& state, Accelerations& accelerations, ThreadPool& threadPool) {
+            assign<dim, TValue>(accelerations, state.size());
+            threadPool.parallelFor(0, state.size(), [&](int begin, int end, int) {
+                for (int i = begin; i < end; i++) {
+                    scatter<dim, TValue>(accelerations, i, a(i, state));
+                }
+            }, 64);
+        };
+    }
+
+    static inline PartialAccelerationCallback perObjectPartial(const ForceCallback& a) {
+        return [a](const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) {
+            threadPool.parallelFor(0, static_cast<int>(targets.size()), [&](int begin, int end, int) {
+                for (int k = begin; k < end; k++) {
+                    scatter<dim, TValue>(accelerations, targets[k], a(targets[k], state));
+                }
+            }, 64);
+        };
+    }
+
+    // uses the engine for full and, if it supports them, partial evaluations
+    template<typename TEngine>
+    inline void setForceEngine(const TEngine& engine)
+        requires dynamicForces
+    {
+        a = engine;
+
+        if constexpr (requires(TEngine engine, const State& state, const std::vector<int>& targets, Accelerations& accelerations, ThreadPool& threadPool) { engine(state, targets, accelerations, threadPool); }) {
+            partialA = engine;
+        }
+        else {
+            partialA = std::nullopt;
+        }
+
+        current.accelerationsValid = false;
+    }
+
+    inline Integrator& getIntegrator() {
+        return current.integrator;
+    }
+
+    inline BroadPhase<dim, TValue>& getBroadPhase() {
+        return broadPhase;
+    }
+
+    // only affects states computed from now on
+    inline void setHistoryPolicy(const HistoryPolicy& policy) {
+        if (policy.keyframeInterval < 1 || policy.recentStates < 0 || policy.intraInterval < 1 || policy.trajectoryLength < 0) {
+            throw std::runtime_error("Invalid history policy");
+        }
+
+        history = policy;
+        recent = RingBuffer<State>(policy.recentStates);
+        storeKeyframe();
+
+        snapshots.clear();
+        decodedTime = -1;
+        if (policy.positionError > 0) {
+            encoder.emplace(static_cast<TValue>(policy.positionError), static_cast<TValue>(policy.velocityError));
+            decoder.emplace(static_cast<TValue>(policy.positionError), static_cast<TValue>(policy.velocityError));
+            storeSnapshot(true);
+        }
+        else {
+            encoder = std::nullopt;
+            decoder = std::nullopt;
+        }
+
+        rebuildTrajectories();
+    }
+
+    inline void setThreadCount(int threadCount, bool deterministic = false) {
+        threadPool = std::make_shared<ThreadPool>(threadCount, deterministic);
+    }
+
+    inline void setThreadPool(const std::shared_ptr<ThreadPool>& threadPool) {
+        this->threadPool = threadPool;
+    }
+
+    inline ThreadPool& getThreadPool() const {
+        return *threadPool;
+    }
+
+    // adds an object to the latest state
     template<typename... TArgs>
-    inline Object& createObject(int time, const TVec& position, const TVec& velocity, const TArgs&... args) {
-        Object& object = states[time].emplaceBack(position, velocity, args...);
-        object.id = objectID++;
+    inline Object createObject(const TVec& position, const TVec& velocity, const TArgs&... args) {
+        const int index = current.state.emplaceBack(position, velocity, args...);
+        current.state.setID(index, current.objectID++);
+        invalidate(current);
 
-        return object;
+        // earlier keyframes do not know the new object
+        storeKeyframe();
+        if (State* stored = recent.find(currentTimeStep)) {
+            *stored = current.state;
+            addMetric(stepMetrics.bytesCopied, current.state.byteSize());
+        }
+        if (encoder.has_value()) {
+            storeSnapshot(true);
+            decodedTime = -1;
+        }
+        if (history.trajectories) {
+            trajectories.append(currentTimeStep, current.state, index);
+        }
+
+        return current.state[index];
     }
 
     inline void step() {
-        std::vector<TVec> accelerations;
+        advance(current, stepMetrics);
+        currentTimeStep++;
+        addMetric(stepMetrics.steps);
 
-        State next = states.back();
-        // velocity verlet
-        for (int i = 0; i < states[currentTimeStep].size(); i++) {
-            const TVec& acceleration = a(i, next);
+        ScopedTimer<> timer(stepMetrics.seconds[Metrics::HISTORY]);
+        if (currentTimeStep % history.keyframeInterval == 0) {
+            storeKeyframe();
+        }
+        if (history.recentStates > 0) {
+            recent.push(currentTimeStep, current.state);
+            addMetric(stepMetrics.bytesCopied, current.state.byteSize());
+        }
 
-            next[i].position = states[currentTimeStep][i].position + states[currentTimeStep][i].velocity * stepSize + acceleration * stepSize * stepSize / static_cast<TValue>(2);
-            accelerations.push_back(acceleration);
+        if (encoder.has_value()) {
+            storeSnapshot(currentTimeStep % history.intraInterval == 0);
         }
 
-        for (int i = 0; i < next.size(); i++) {
-            const TVec& nextAcceleration = a(i, next);
-            next[i].velocity = next[i].velocity + (accelerations[i] + nextAcceleration) * stepSize / static_cast<TValue>(2);
+        if (history.trajectories) {
+            trajectories.append(currentTimeStep, current.state);
+            addMetric(stepMetrics.bytesCopied, current.state.size() * 2 * dim * sizeof(TValue));
         }
+    }
 
-        currentTimeStep++;
-        if (handleCollisions) {
-            // check for collisions
-            std::map<int, std::vector<int>> collisions;
-            std::set<int> objectsToRemove;
-
-            for (int i = 0; i < next.size(); i++) {
-                for (int j = 0; j < i; j++) {
-                    if (collide(next[i], next[j])) {
-                        collisions[i].push_back(j);
-                        objectsToRemove.insert({i, j});
-                    }
-                }
+    // timings and counters since the construction or the last reset, getState only adds to the reconstruction time
+    inline Metrics metrics() const {
+        Metrics result = stepMetrics;
+        result.seconds[Metrics::RECONSTRUCTION] = reconstructionMetrics.getTotalSeconds();
+
+        return result;
+    }
+
+    inline void resetMetrics() {
+        stepMetrics = Metrics();
+        reconstructionMetrics = Metrics();
+    }
+
+    inline int endTime() const {
+        return currentTimeStep;
+    }
+
+    // earliest state that is available, later than 0 after loading a checkpoint without history
+    inline int startTime() const {
+        return firstTimeStep;
+    }
+
+    // Appends everything needed to continue the run. Continuing from the loaded checkpoint gives bitwise identical
+    // states as long as the force engine and the thread pool are deterministic. Without the history only the latest
+    // state is stored, which keeps frequent checkpoints of long runs cheap.
+    inline void saveCheckpoint(std::vector<char>& buffer, bool withHistory = true) const {
+        CheckpointHeader header;
+        std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+        header.version = checkpointVersion;
+        header.dim = dim;
+        header.valueSize = sizeof(TValue);
+        header.attributeSize = sizeof(T);
+        appendValue(buffer, header);
+
+        appendValue(buffer, stepSize);
+        appendValue(buffer, currentTimeStep);
+        appendValue(buffer, history);
+        appendKeyframe(buffer, current);
+
+        appendValue(buffer, withHistory);
+        if (!withHistory) {
+            return;
+        }
+
+        appendValue(buffer, firstTimeStep);
+        appendValue(buffer, static_cast<std::uint64_t>(keyframes.size()));
+        for (const auto& [time, keyframe] : keyframes) {
+            appendValue(buffer, time);
+            appendKeyframe(buffer, keyframe);
+        }
+
+        appendValue(buffer, static_cast<std::uint64_t>(snapshots.size()));
+        for (const auto& [time, snapshot] : snapshots) {
+            appendValue(buffer, time);
+            appendVector(buffer, snapshot);
+        }
+    }
+
+    // replaces the whole simulation except the callbacks, the force engine and the thread pool
+    inline void loadCheckpoint(const char* data, std::size_t size) {
+        ByteReader reader(data, size);
+
+        const CheckpointHeader header = reader.read<CheckpointHeader>();
+        if (std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0 || header.version != checkpointVersion) {
+            throw std::runtime_error("Not a checkpoint");
+        }
+        if (header.dim != dim || header.valueSize != sizeof(TValue) || header.attributeSize != sizeof(T)) {
+            throw std::runtime_error("The checkpoint was written with different simulation parameters");
+        }
+
+        // everything is read into locals first, a checkpoint that fails to load leaves the simulation unchanged
+        const TValue loadedStepSize = reader.read<TValue>();
+        const int loadedTimeStep = reader.read<int>();
+        const HistoryPolicy policy = reader.read<HistoryPolicy>();
+        Keyframe loadedCurrent;
+        readKeyframe(reader, loadedCurrent);
+
+        int loadedFirstTimeStep = loadedTimeStep;
+        std::map<int, Keyframe> loadedKeyframes;
+        std::map<int, std::vector<char>> loadedSnapshots;
+        if (reader.read<bool>()) {
+            loadedFirstTimeStep = reader.read<int>();
+
+            const std::uint64_t keyframeCount = reader.read<std::uint64_t>();
+            for (std::uint64_t k = 0; k < keyframeCount; k++) {
+                const int time = reader.read<int>();
+                readKeyframe(reader, loadedKeyframes[time]);
             }
 
-            for (const auto& [index, colls] : collisions) {
-                next.emplace_back(onCollision.value()(index, colls, next));
+            const std::uint64_t snapshotCount = reader.read<std::uint64_t>();
+            for (std::uint64_t k = 0; k < snapshotCount; k++) {
+                const int time = reader.read<int>();
+                reader.readVector(loadedSnapshots[time]);
             }
+        }
+        else {
+            loadedKeyframes[loadedTimeStep] = loadedCurrent;
+        }
+
+        if (!reader.atEnd() || loadedKeyframes.empty() || loadedKeyframes.begin()->first != loadedFirstTimeStep || loadedFirstTimeStep > loadedTimeStep) {
+            throw std::runtime_error("Corrupt checkpoint");
+        }
+        if (policy.keyframeInterval < 1 || policy.recentStates < 0 || policy.intraInterval < 1 || policy.trajectoryLength < 0) {
+            throw std::runtime_error("Corrupt checkpoint");
+        }
 
-            for (auto it = objectsToRemove.rbegin(); it != objectsToRemove.rend(); it++) {
-                next.erase(next.begin() + *it);
+        RingBuffer<State> loadedRecent(policy.recentStates);
+        std::optional<Codec> loadedEncoder = std::nullopt;
+        std::optional<Codec> loadedDecoder = std::nullopt;
+        if (policy.positionError > 0) {
+            loadedEncoder.emplace(static_cast<TValue>(policy.positionError), static_cast<TValue>(policy.velocityError));
+            loadedDecoder.emplace(static_cast<TValue>(policy.positionError), static_cast<TValue>(policy.velocityError));
+        }
+
+        stepSize = loadedStepSize;
+        currentTimeStep = loadedTimeStep;
+        firstTimeStep = loadedFirstTimeStep;
+        history = policy;
+        current = std::move(loadedCurrent);
+        keyframes = std::move(loadedKeyframes);
+        snapshots = std::move(loadedSnapshots);
+        recent = std::move(loadedRecent);
+        encoder = std::move(loadedEncoder);
+        decoder = std::move(loadedDecoder);
+        cursor = std::nullopt;
+        decodedTime = -1;
+
+        // the encoder starts over with an intra frame, which decodes to the same state
+        if (encoder.has_value()) {
+            storeSnapshot(true);
+        }
+
+        rebuildTrajectories();
+    }
+
+    // States that are not stored are decoded from the compressed history or integrated again from the closest
+    // keyframe before them, the returned reference may be invalidated by the next call. Bitwise identical results
+    // of the integration require a deterministic thread pool.
+    inline const State& getState(int time) const {
+        if (time < firstTimeStep || time > currentTimeStep) {
+            throw std::out_of_range("No state at time " + std::to_string(time));
+        }
+
+        if (time == currentTimeStep) {
+            return current.state;
+        }
+        if (const State* stored = recent.find(time)) {
+            return *stored;
+        }
+
+        const auto keyframe = std::prev(keyframes.upper_bound(time));
+        if (keyframe->first == time) {
+            return keyframe->second.state;
+        }
+
+        if (const auto snapshot = snapshots.find(time); snapshot != snapshots.end()) {
+            auto intra = snapshot;
+            while (!Codec::isIntra(intra->second.data())) {
+                intra--;
+            }
+
+            // sequential access continues from the last decoded state
+            auto next = intra;
+            if (decodedTime >= intra->first && decodedTime < time) {
+                next = snapshots.find(decodedTime + 1);
+            }
+
+            ScopedTimer<> timer(reconstructionMetrics.seconds[Metrics::HISTORY]);
+            for (; next != std::next(snapshot); next++) {
+                decoder->decode(next->second.data(), next->second.size(), decoded);
             }
+
+            decodedTime = time;
+            return decoded;
+        }
+
+        // sequential access continues from the last reconstructed state
+        if (!cursor.has_value() || cursorTime > time || cursorTime < keyframe->first) {
+            cursor = keyframe->second;
+            cursorTime = keyframe->first;
         }
 
-        states.push_back(next);
+        while (cursorTime < time) {
+            advance(cursor.value(), reconstructionMetrics);
+            cursorTime++;
+        }
+
+        return cursor.value().state;
     }
 
-    inline int endTime() const {
-        return currentTimeStep;
+  private:
+    static inline void appendKeyframe(std::vector<char>& buffer, const Keyframe& keyframe) {
+        appendState(buffer, keyframe.state);
+        appendColumns<dim, TValue>(buffer, keyframe.accelerations);
+        appendValue(buffer, keyframe.accelerationsValid);
+        appendValue(buffer, keyframe.objectID);
+
+        // the other integrators only keep scratch buffers between the steps
+        if constexpr (requires { keyframe.integrator.save(buffer); }) {
+            keyframe.integrator.save(buffer);
+        }
     }
 
-    inline const State& getState(int time) const {
-        return states[time];
+    static inline void readKeyframe(ByteReader& reader, Keyframe& keyframe) {
+        readState(reader, keyframe.state);
+        readColumns<dim, TValue>(reader, keyframe.accelerations);
+        keyframe.accelerationsValid = reader.read<bool>();
+        keyframe.objectID = reader.read<int>();
+
+        if constexpr (requires { keyframe.integrator.load(reader); }) {
+            keyframe.integrator.load(reader);
+        }
+    }
+
+    inline void initialize(State&& initialState) {
+        current.state = std::move(initialState);
+        for (int i = 0; i < current.state.size(); i++) {
+            current.state.setID(i, current.objectID++);
+        }
+
+        keyframes[0] = current;
+    }
+
+    // the table starts over with the stored history within its length when the policy or the whole simulation is
+    // replaced
+    inline void rebuildTrajectories() {
+        trajectories = TrajectoryTable<dim, TValue>(history.trajectoryLength);
+        if (!history.trajectories) {
+            return;
+        }
+
+        const int begin = history.trajectoryLength > 0 ? std::max(firstTimeStep, currentTimeStep - history.trajectoryLength + 1) : firstTimeStep;
+        for (int time = begin; time <= currentTimeStep; time++) {
+            trajectories.append(time, getState(time));
+        }
+    }
+
+    inline void storeKeyframe() {
+        keyframes[currentTimeStep] = current;
+
+        const std::size_t size = current.state.byteSize() + dim * current.accelerations[0].size() * sizeof(TValue);
+        addMetric(stepMetrics.bytesCopied, size);
+        addMetric(stepMetrics.bytesAllocated, size);
+    }
+
+    inline void storeSnapshot(bool intra) {
+        if (intra) {
+            encoder->reset();
+        }
+
+        std::vector<char>& snapshot = snapshots[currentTimeStep];
+        snapshot.clear();
+        encoder->encode(current.state, snapshot, intra);
+        addMetric(stepMetrics.bytesAllocated, snapshot.size());
+    }
+
+    inline void invalidate(Keyframe& keyframe) const {
+        keyframe.accelerationsValid = false;
+
+        if constexpr (requires { keyframe.integrator.reset(); }) {
+            keyframe.integrator.reset();
+        }
     }
 
-    inline std::vector<Trajectory> getTrajectories() const {
-        std::map<int, Trajectory> trajectories;
+    inline void advance(Keyframe& keyframe, Metrics& metrics) const {
+        State& next = keyframe.state;
+        const Evaluator evaluate{*this, metrics};
+
+        if (!keyframe.accelerationsValid) {
+            evaluate(next, keyframe.accelerations);
+        }
+
+        {
+            ScopedTimer<> timer(metrics.seconds[Metrics::INTEGRATION]);
+            const double forces = metrics.seconds[Metrics::FORCES];
 
-        for (const auto& state : states) {
-            for (const auto& object : state) {
-                trajectories[object.id].positions.push_back(object.position);
-                trajectories[object.id].velocities.push_back(object.velocity);
+            keyframe.integrator.step(next, keyframe.accelerations, stepSize, evaluate, *threadPool);
+            keyframe.accelerationsValid = true;
+
+            // the force evaluations were timed on their own
+            metrics.seconds[Metrics::INTEGRATION] -= metrics.seconds[Metrics::FORCES] - forces;
+        }
+
+        if (handleCollisions) {
+            ScopedTimer<> timer(metrics.seconds[Metrics::COLLISIONS]);
+
+            // exact test of the candidates
+            collisionPairs.clear();
+            broadPhase.findPairs(next.positions, next.radii, collisionPairs);
+            addMetric(metrics.collisionCandidates, collisionPairs.size());
+
+            std::erase_if(collisionPairs, [&](const std::pair<int, int>& pair) {
+                return !collide(next[pair.first], next[pair.second]);
+            });
+            addMetric(metrics.collisions, collisionPairs.size());
+
+            if (!collisionPairs.empty()) {
+                // every connected group of colliding bodies is merged into one
+                const int count = next.size();
+                clusters.reset(count);
+                removed.assign(count, false);
+
+                for (const auto& [i, j] : collisionPairs) {
+                    clusters.unite(i, j);
+                    removed[i] = true;
+                    removed[j] = true;
+                }
+
+                // members ordered by the largest index of their cluster, which is the last one in ascending order
+                clusterMembers.clear();
+                largestMember.resize(count);
+                for (int i = 0; i < count; i++) {
+                    if (removed[i]) {
+                        largestMember[clusters.find(i)] = i;
+                    }
+                }
+                for (int i = 0; i < count; i++) {
+                    if (removed[i]) {
+                        clusterMembers.emplace_back(largestMember[clusters.find(i)], i);
+                    }
+                }
+                std::sort(clusterMembers.begin(), clusterMembers.end());
+
+                mergedObjects.clear();
+                for (auto member = clusterMembers.begin(); member != clusterMembers.end();) {
+                    const int index = member->first;
+
+                    collisionGroup.clear();
+                    for (; member->second != index; member++) {
+                        collisionGroup.push_back(member->second);
+                    }
+                    member++;
+
+                    mergedObjects.push_back(onCollision.value()(index, collisionGroup, next));
+                }
+
+                addMetric(metrics.merges, mergedObjects.size());
+
+                next.compact(removed);
+                for (const Object& object : mergedObjects) {
+                    next.setID(next.pushBack(object), keyframe.objectID++);
+                }
+
+                // the cached accelerations belong to the state before the merges
+                invalidate(keyframe);
             }
         }
+    }
 
-        std::vector<Trajectory> result;
-        result.reserve(trajectories.size());
+  public:
+    // Positions and velocities of one body within [begin, end) every stride steps, which only reads the samples of
+    // that body. Requires HistoryPolicy::trajectories, the view is invalidated by the next step.
+    inline TrajectoryView getTrajectory(int id, int begin, int end, int stride = 1) const {
+        if (!history.trajectories) {
+            throw std::runtime_error("Trajectories are not recorded, enable them in the history policy");
+        }
+        if (stride < 1) {
+            throw std::runtime_error("Invalid trajectory stride");
+        }
+
+        return trajectories.get(id, begin, end, stride);
+    }
 
-        for (auto& [id, trajectory] : trajectories) {
-            trajectory.objectId = id;
-            result.push_back(trajectory);
+    // trajectories of all bodies that existed within [begin, end)
+    inline std::vector<TrajectoryView> getTrajectories(int begin, int end, int stride = 1) const {
+        std::vector<TrajectoryView> result;
+        for (int id = 0; id < trajectories.size(); id++) {
+            TrajectoryView view = getTrajectory(id, begin, end, stride);
+            if (!view.empty()) {
+                result.push_back(view);
+            }
         }
 
         return result;
     }
 
   private:
-    ForceCallback a;
+    struct Evaluator {
+        const Simulation& simulation;
+        Metrics& metrics;
+
+        inline void operator()(const State& state, Accelerations& accelerations) const {
+            ScopedTimer<> timer(metrics.seconds[Metrics::FORCES]);
+            addMetric(metrics.forceEvaluations);
+            addMetric(metrics.pairInteractions, static_cast<std::uint64_t>(state.size()) * std::max(state.size() - 1, 0));
+
+            simulation.a(state, accelerations, *simulation.threadPool);
+        }
+
+        inline void operator()(const State& state, const std::vector<int>& targets, Accelerations& accelerations) const {
+            ScopedTimer<> timer(metrics.seconds[Metrics::FORCES]);
+            addMetric(metrics.partialForceEvaluations);
+            addMetric(metrics.pairInteractions, targets.size() * std::max(state.size() - 1, 0));
+
+            if constexpr (!dynamicForces) {
+                simulation.a(state, targets, accelerations, *simulation.threadPool);
+                return;
+            }
+            else if (simulation.partialA.has_value()) {
+                simulation.partialA.value()(state, targets, accelerations, *simulation.threadPool);
+                return;
+            }
 
-    std::optional<CollisionCallback> onCollision = std::nullopt;
+            simulation.a(state, simulation.fullAccelerations, *simulation.threadPool);
+            for (int i : targets) {
+                for (int d = 0; d < dim; d++) {
+                    accelerations[d][i] = simulation.fullAccelerations[d][i];
+                }
+            }
+        }
+    };
+
+    // the direct sum of a force law keeps per thread buffers
+    mutable ForceEngine a;
+    std::optional<PartialAccelerationCallback> partialA = std::nullopt;
+    // fallback for partial evaluations without a partial callback
+    mutable Accelerations fullAccelerations;
+    std::shared_ptr<ThreadPool> threadPool = std::make_shared<ThreadPool>(1);
+
+    // latest state
+    Keyframe current;
+
+    HistoryPolicy history;
+    std::map<int, Keyframe> keyframes;
+    RingBuffer<State> recent;
+
+    mutable std::optional<Keyframe> cursor = std::nullopt;
+    mutable int cursorTime = 0;
+
+    std::optional<Codec> encoder = std::nullopt;
+    std::map<int, std::vector<char>> snapshots;
+    mutable std::optional<Codec> decoder = std::nullopt;
+    mutable State decoded;
+    mutable int decodedTime = -1;
+
+    Metrics stepMetrics;
+    mutable Metrics reconstructionMetrics;
+
+    TrajectoryTable<dim, TValue> trajectories;
+
+    std::optional<MergeFunction> onCollision = std::nullopt;
     bool handleCollisions = false;
 
+    mutable BroadPhase<dim, TValue> broadPhase;
+    mutable std::vector<std::pair<int, int>> collisionPairs;
+    mutable std::vector<int> collisionGroup;
+    mutable UnionFind clusters;
+    mutable std::vector<int> largestMember;
+    mutable std::vector<std::pair<int, int>> clusterMembers;
+    mutable std::vector<Object> mergedObjects;
+    mutable std::vector<char> removed;
+
     int currentTimeStep = 0;
+    int firstTimeStep = 0;
 };
\ No newline at end of file
@@ -0,0 +1,295 @@
+#pragma once
+#include "state.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Lossy compression of states. Positions and velocities are rounded to a grid whose spacing is twice the error
+// bound, so every component is reconstructed within the bound. Delta frames store the difference to the grid
+// values of the previous frame, intra frames the grid values themselves. Each column is stored relative to its
+// minimum and bit packed with the width of its largest value. Only intra frames store the bodies, a frame whose
+// bodies differ from the previous one is always an intra frame.
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class SnapshotCodec {
+    static_assert(std::is_trivially_copyable_v<T>, "The attributes are stored as raw bytes");
+
+  public:
+    using State = SoAState<dim, TValue, T>;
+
+  private:
+    using Grid = std::vector<std::int64_t>;
+
+    TValue positionStep;
+    TValue velocityStep;
+
+    // grid values of the last encoded or decoded frame
+    bool hasReference = false;
+    std::array<Grid, 2 * dim> reference;
+    // bodies of the last intra frame
+    Column<TValue> referenceMasses;
+    Column<TValue> referenceRadii;
+    std::vector<int> referenceIds;
+    std::vector<T> referenceAttributes;
+    std::array<Grid, 2 * dim> next;
+
+    template<typename TData>
+    static inline void append(std::vector<char>& buffer, const TData* values, std::size_t count) {
+        const std::size_t offset = buffer.size();
+        buffer.resize(offset + count * sizeof(TData));
+        std::memcpy(buffer.data() + offset, values, count * sizeof(TData));
+    }
+
+    template<typename TData>
+    static inline void load(const char*& data, const char* end, TData* values, std::size_t count) {
+        if (data + count * sizeof(TData) > end) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+
+        std::memcpy(values, data, count * sizeof(TData));
+        data += count * sizeof(TData);
+    }
+
+    static inline std::int64_t quantize(TValue value, TValue step) {
+        const TValue scaled = std::round(value / step);
+        if (!(std::abs(scaled) < static_cast<TValue>(std::int64_t(1) << 62))) {
+            throw std::runtime_error("Value is out of range for the snapshot error bound");
+        }
+
+        return static_cast<std::int64_t>(scaled);
+    }
+
+    static inline void pack(std::vector<char>& buffer, const Grid& values) {
+        std::int64_t minimum = std::numeric_limits<std::int64_t>::max();
+        std::int64_t maximum = std::numeric_limits<std::int64_t>::min();
+        for (std::int64_t value : values) {
+            minimum = std::min(minimum, value);
+            maximum = std::max(maximum, value);
+        }
+        if (values.empty()) {
+            minimum = maximum = 0;
+        }
+
+        const std::uint8_t bits = static_cast<std::uint8_t>(std::bit_width(static_cast<std::uint64_t>(maximum - minimum)));
+        append(buffer, &minimum, 1);
+        append(buffer, &bits, 1);
+
+        if (bits == 0) {
+            return;
+        }
+
+        const std::size_t offset = buffer.size();
+        buffer.resize(offset + (values.size() * bits + 7) / 8);
+        unsigned char* output = reinterpret_cast<unsigned char*>(buffer.data() + offset);
+
+        // less than 8 bits are pending after every flush, so 56 more always fit
+        std::uint64_t word = 0;
+        int pending = 0;
+        for (std::int64_t value : values) {
+            std::uint64_t packed = static_cast<std::uint64_t>(value - minimum);
+
+            for (int remaining = bits; remaining > 0;) {
+                const int count = std::min(remaining, 56);
+                word |= (packed & ((std::uint64_t(1) << count) - 1)) << pending;
+                packed >>= count;
+                pending += count;
+                remaining -= count;
+
+                while (pending >= 8) {
+                    *output++ = static_cast<unsigned char>(word);
+                    word >>= 8;
+                    pending -= 8;
+                }
+            }
+        }
+
+        if (pending > 0) {
+            *output = static_cast<unsigned char>(word);
+        }
+    }
+
+    static inline void unpack(const char*& data, const char* end, Grid& values) {
+        std::int64_t minimum;
+        std::uint8_t bits;
+        load(data, end, &minimum, 1);
+        load(data, end, &bits, 1);
+
+        if (bits == 0) {
+            std::fill(values.begin(), values.end(), minimum);
+            return;
+        }
+
+        const std::size_t byteCount = (values.size() * bits + 7) / 8;
+        if (bits > 64 || data + byteCount > end) {
+            throw std::runtime_error("Snapshot is truncated");
+        }
+
+        const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+        std::uint64_t word = 0;
+        int available = 0;
+        for (std::int64_t& value : values) {
+            std::uint64_t packed = 0;
+
+            for (int read = 0; read < bits;) {
+                if (available == 0) {
+                    word = *input++;
+                    available = 8;
+                }
+
+                const int count = std::min(available, bits - read);
+                packed |= (word & ((std::uint64_t(1) << count) - 1)) << read;
+                word >>= count;
+                available -= count;
+                read += count;
+            }
+
+            value = minimum + static_cast<std::int64_t>(packed);
+        }
+
+        data += byteCount;
+    }
+
+    inline TValue step(int column) const {
+        return column < dim ? positionStep : velocityStep;
+    }
+
+    inline const Column<TValue>& column(const State& state, int column) const {
+        return column < dim ? state.positions[column] : state.velocities[column - dim];
+    }
+
+    inline Column<TValue>& column(State& state, int column) const {
+        return column < dim ? state.positions[column] : state.velocities[column - dim];
+    }
+
+  public:
+    inline SnapshotCodec(TValue positionError, TValue velocityError)
+        : positionStep(2 * positionError), velocityStep(2 * velocityError) {
+        if (!(positionError > 0) || !(velocityError > 0)) {
+            throw std::runtime_error("The snapshot error bounds have to be positive");
+        }
+    }
+
+    // the next frame is encoded or decoded without reference
+    inline void reset() {
+        hasReference = false;
+    }
+
+    static inline bool isIntra(const char* data) {
+        return data[0] != 0;
+    }
+
+    // appends the compressed state to the buffer
+    inline void encode(const State& state, std::vector<char>& buffer, bool intra = false) {
+        const std::uint32_t count = state.size();
+        intra = intra || !hasReference || referenceIds != state.ids;
+
+        const std::uint8_t flag = intra;
+        append(buffer, &flag, 1);
+        append(buffer, &count, 1);
+
+        if (intra) {
+            append(buffer, state.masses.data(), count);
+            append(buffer, state.radii.data(), count);
+            append(buffer, state.ids.data(), count);
+            append(buffer, state.attributes.data(), count);
+        }
+
+        for (int c = 0; c < 2 * dim; c++) {
+            const Column<TValue>& values = column(state, c);
+            Grid& grid = next[c];
+            grid.resize(count);
+
+            for (std::size_t i = 0; i < count; i++) {
+                grid[i] = quantize(values[i], step(c));
+            }
+
+            if (intra) {
+                pack(buffer, grid);
+            }
+            else {
+                // the delta is taken against the previous frame, so the reference takes the old values
+                Grid& delta = reference[c];
+                for (std::size_t i = 0; i < count; i++) {
+                    delta[i] = grid[i] - delta[i];
+                }
+
+                pack(buffer, delta);
+            }
+
+            std::swap(reference[c], grid);
+        }
+
+        if (intra) {
+            referenceIds = state.ids;
+        }
+        hasReference = true;
+    }
+
+    // the state may be reused between calls, decoding is fastest when it holds the previous frame
+    inline void decode(const char* data, std::size_t size, State& state) {
+        const char* end = data + size;
+
+        std::uint8_t flag;
+        std::uint32_t count;
+        load(data, end, &flag, 1);
+        load(data, end, &count, 1);
+
+        const bool intra = flag != 0;
+        if (intra) {
+            state.masses.resize(count);
+            state.radii.resize(count);
+            state.ids.resize(count);
+            state.attributes.resize(count);
+
+            load(data, end, state.masses.data(), count);
+            load(data, end, state.radii.data(), count);
+            load(data, end, state.ids.data(), count);
+            load(data, end, state.attributes.data(), count);
+            state.rebuildIndices();
+
+            referenceMasses = state.masses;
+            referenceRadii = state.radii;
+            referenceIds = state.ids;
+            referenceAttributes = state.attributes;
+        }
+        else if (!hasReference || referenceIds.size() != count) {
+            throw std::runtime_error("Delta snapshot without matching reference");
+        }
+        else if (state.ids != referenceIds) {
+            state.masses = referenceMasses;
+            state.radii = referenceRadii;
+            state.ids = referenceIds;
+            state.attributes = referenceAttributes;
+            state.rebuildIndices();
+        }
+
+        for (int c = 0; c < 2 * dim; c++) {
+            Grid& grid = next[c];
+            grid.resize(count);
+            unpack(data, end, grid);
+
+            if (!intra) {
+                for (std::size_t i = 0; i < count; i++) {
+                    grid[i] += reference[c][i];
+                }
+            }
+
+            Column<TValue>& values = column(state, c);
+            values.resize(count);
+            for (std::size_t i = 0; i < count; i++) {
+                values[i] = static_cast<TValue>(grid[i]) * step(c);
+            }
+
+            std::swap(reference[c], grid);
+        }
+
+        hasReference = true;
+    }
+};
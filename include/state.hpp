@@ -0,0 +1,358 @@
+#pragma once
+#include "object.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <vector>
+
+template<typename TValue, std::size_t alignment = 64>
+struct AlignedAllocator {
+    using value_type = TValue;
+
+    template<typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, alignment>;
+    };
+
+    inline AlignedAllocator() = default;
+
+    template<typename U>
+    inline AlignedAllocator(const AlignedAllocator<U, alignment>&) {
+    }
+
+    inline TValue* allocate(std::size_t count) {
+        return static_cast<TValue*>(::operator new(count * sizeof(TValue), std::align_val_t(alignment)));
+    }
+
+    inline void deallocate(TValue* pointer, std::size_t) {
+        ::operator delete(pointer, std::align_val_t(alignment));
+    }
+
+    template<typename U>
+    inline bool operator==(const AlignedAllocator<U, alignment>&) const {
+        return true;
+    }
+};
+
+template<typename TValue>
+using Column = std::vector<TValue, AlignedAllocator<TValue>>;
+
+// one column per vector component
+template<int dim, typename TValue>
+using VectorColumns = std::array<Column<TValue>, dim>;
+
+template<int dim, typename TValue>
+inline glm::vec<dim, TValue> gather(const VectorColumns<dim, TValue>& columns, int index) {
+    glm::vec<dim, TValue> result;
+    for (int d = 0; d < dim; d++) {
+        result[d] = columns[d][index];
+    }
+
+    return result;
+}
+
+template<int dim, typename TValue>
+inline void scatter(VectorColumns<dim, TValue>& columns, int index, const glm::vec<dim, TValue>& value) {
+    for (int d = 0; d < dim; d++) {
+        columns[d][index] = value[d];
+    }
+}
+
+// copy that grows the capacity of the target geometrically, so repeated copies of slowly growing vectors stop
+// allocating, which the copy assignment of std::vector does not guarantee
+template<typename TVector>
+inline void copyInto(TVector& target, const TVector& source) {
+    if (target.capacity() < source.size()) {
+        target.reserve(std::max(source.size(), 2 * target.capacity()));
+    }
+
+    target.assign(source.begin(), source.end());
+}
+
+template<int dim, typename TValue>
+inline void assign(VectorColumns<dim, TValue>& columns, std::size_t size, TValue value = 0) {
+    for (auto& column : columns) {
+        column.assign(size, value);
+    }
+}
+
+// structure of arrays storage of all objects at one point in time
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class SoAState {
+  public:
+    using ObjectType = Object<dim, TValue, T>;
+    using TVec = ObjectType::TVec;
+
+    VectorColumns<dim, TValue> positions;
+    VectorColumns<dim, TValue> velocities;
+    Column<TValue> masses;
+    Column<TValue> radii;
+    std::vector<int> ids;
+    std::vector<T> attributes;
+
+    class const_iterator {
+        const SoAState* state;
+        int index;
+
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ObjectType;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ObjectType;
+
+        inline const_iterator(const SoAState* state = nullptr, int index = 0)
+            : state(state), index(index) {
+        }
+
+        inline ObjectType operator*() const {
+            return (*state)[index];
+        }
+
+        inline const_iterator& operator++() {
+            index++;
+            return *this;
+        }
+
+        inline const_iterator operator++(int) {
+            const_iterator result = *this;
+            index++;
+            return result;
+        }
+
+        inline bool operator==(const const_iterator& other) const {
+            return index == other.index;
+        }
+    };
+
+    inline SoAState() = default;
+
+    inline SoAState(const std::vector<ObjectType>& objects) {
+        reserve(objects.size());
+
+        for (const auto& object : objects) {
+            pushBack(object);
+        }
+    }
+
+    inline int size() const {
+        return static_cast<int>(ids.size());
+    }
+
+    inline bool empty() const {
+        return ids.empty();
+    }
+
+    // bytes of the stored bodies, without the id table and unused capacity
+    inline std::size_t byteSize() const {
+        return ids.size() * (2 * dim * sizeof(TValue) + 2 * sizeof(TValue) + sizeof(int) + sizeof(T));
+    }
+
+    // same as the copy assignment but keeps the storage of this state wherever it is large enough
+    inline void copyFrom(const SoAState& other) {
+        for (int d = 0; d < dim; d++) {
+            copyInto(positions[d], other.positions[d]);
+            copyInto(velocities[d], other.velocities[d]);
+        }
+        copyInto(masses, other.masses);
+        copyInto(radii, other.radii);
+        copyInto(ids, other.ids);
+        copyInto(attributes, other.attributes);
+        copyInto(indices, other.indices);
+    }
+
+    inline void reserve(std::size_t capacity) {
+        for (int d = 0; d < dim; d++) {
+            positions[d].reserve(capacity);
+            velocities[d].reserve(capacity);
+        }
+        masses.reserve(capacity);
+        radii.reserve(capacity);
+        ids.reserve(capacity);
+        attributes.reserve(capacity);
+    }
+
+    // Bodies without id and with unset values. Loaders write the positions, velocities and attributes directly and
+    // derive the masses and radii with updateDerived afterwards, which avoids building every object on its own.
+    inline void resize(std::size_t count) {
+        for (int d = 0; d < dim; d++) {
+            positions[d].resize(count);
+            velocities[d].resize(count);
+        }
+        masses.resize(count);
+        radii.resize(count);
+        ids.resize(count, -1);
+        attributes.resize(count);
+    }
+
+    // masses and radii of the bodies in [begin, end) from their attributes
+    inline void updateDerived(int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            masses[i] = static_cast<TValue>(attributes[i].mass);
+            radii[i] = radiusOf(attributes[i]);
+        }
+    }
+
+    // index of the object with the given id or -1
+    inline int indexOf(int id) const {
+        return id >= 0 && id < static_cast<int>(indices.size()) ? indices[id] : -1;
+    }
+
+    inline void setID(int index, int id) {
+        if (ids[index] >= 0 && indexOf(ids[index]) == index) {
+            indices[ids[index]] = -1;
+        }
+
+        ids[index] = id;
+        track(index);
+    }
+
+    // needed after the ids were written directly
+    inline void rebuildIndices() {
+        indices.clear();
+        for (int i = 0; i < size(); i++) {
+            track(i);
+        }
+    }
+
+    inline TVec position(int index) const {
+        return gather<dim, TValue>(positions, index);
+    }
+
+    inline TVec velocity(int index) const {
+        return gather<dim, TValue>(velocities, index);
+    }
+
+    inline void setPosition(int index, const TVec& position) {
+        scatter<dim, TValue>(positions, index, position);
+    }
+
+    inline void setVelocity(int index, const TVec& velocity) {
+        scatter<dim, TValue>(velocities, index, velocity);
+    }
+
+    inline ObjectType operator[](int index) const {
+        ObjectType object(position(index), velocity(index));
+        object.attributes = attributes[index];
+        object.id = ids[index];
+
+        return object;
+    }
+
+    inline void set(int index, const ObjectType& object) {
+        setPosition(index, object.position);
+        setVelocity(index, object.velocity);
+        masses[index] = static_cast<TValue>(object.attributes.mass);
+        radii[index] = radiusOf(object.attributes);
+        attributes[index] = object.attributes;
+        setID(index, object.id);
+    }
+
+    inline int pushBack(const ObjectType& object) {
+        for (int d = 0; d < dim; d++) {
+            positions[d].push_back(object.position[d]);
+            velocities[d].push_back(object.velocity[d]);
+        }
+        masses.push_back(static_cast<TValue>(object.attributes.mass));
+        radii.push_back(radiusOf(object.attributes));
+        ids.push_back(object.id);
+        attributes.push_back(object.attributes);
+        track(size() - 1);
+
+        return size() - 1;
+    }
+
+    template<typename... TArgs>
+    inline int emplaceBack(const TVec& position, const TVec& velocity, const TArgs&... args) {
+        return pushBack(ObjectType(position, velocity, args...));
+    }
+
+    inline void erase(int index) {
+        for (int d = 0; d < dim; d++) {
+            positions[d].erase(positions[d].begin() + index);
+            velocities[d].erase(velocities[d].begin() + index);
+        }
+        masses.erase(masses.begin() + index);
+        radii.erase(radii.begin() + index);
+        attributes.erase(attributes.begin() + index);
+
+        if (indexOf(ids[index]) == index) {
+            indices[ids[index]] = -1;
+        }
+        ids.erase(ids.begin() + index);
+        for (int i = index; i < size(); i++) {
+            track(i);
+        }
+    }
+
+    // removes all objects whose flag is set in a single pass, the others keep their order
+    inline void compact(const std::vector<char>& removed) {
+        int kept = 0;
+        for (int i = 0; i < size(); i++) {
+            if (removed[i]) {
+                if (indexOf(ids[i]) == i) {
+                    indices[ids[i]] = -1;
+                }
+                continue;
+            }
+
+            if (kept != i) {
+                for (int d = 0; d < dim; d++) {
+                    positions[d][kept] = positions[d][i];
+                    velocities[d][kept] = velocities[d][i];
+                }
+                masses[kept] = masses[i];
+                radii[kept] = radii[i];
+                ids[kept] = ids[i];
+                attributes[kept] = attributes[i];
+                track(kept);
+            }
+            kept++;
+        }
+
+        for (int d = 0; d < dim; d++) {
+            positions[d].resize(kept);
+            velocities[d].resize(kept);
+        }
+        masses.resize(kept);
+        radii.resize(kept);
+        ids.resize(kept);
+        attributes.resize(kept);
+    }
+
+    inline const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    inline const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+  private:
+    // index of every id, ids are small and increasing so a vector is enough
+    std::vector<int> indices;
+
+    inline void track(int index) {
+        const int id = ids[index];
+        if (id < 0) {
+            return;
+        }
+
+        if (id >= static_cast<int>(indices.size())) {
+            indices.resize(id + 1, -1);
+        }
+        indices[id] = index;
+    }
+
+    static inline TValue radiusOf(const T& attributes) {
+        if constexpr (requires { attributes.radius; }) {
+            return static_cast<TValue>(attributes.radius);
+        }
+        else {
+            return 0;
+        }
+    }
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+// Persistently mapped buffer that the CPU writes while the GPU still reads the previous frames. The storage is
+// split into regionCount regions that are used in turn, a fence per region tells when the GPU is done with it.
+class StreamingBuffer {
+  public:
+    static constexpr int regionCount = 3;
+
+  private:
+    unsigned int buffer = 0;
+    std::size_t regionSize = 0;
+    char* mapped = nullptr;
+
+    GLsync fences[regionCount] = {};
+    int region = 0;
+
+    inline void waitFor(int region) {
+        if (fences[region] == nullptr) {
+            return;
+        }
+
+        while (true) {
+            const GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+                break;
+            }
+            if (result == GL_WAIT_FAILED) {
+                throw std::runtime_error("Waiting for the streaming buffer failed");
+            }
+        }
+
+        glDeleteSync(fences[region]);
+        fences[region] = nullptr;
+    }
+
+    inline void release() {
+        for (GLsync& fence : fences) {
+            if (fence != nullptr) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (buffer != 0) {
+            glUnmapNamedBuffer(buffer);
+            glDeleteBuffers(1, &buffer);
+            buffer = 0;
+            mapped = nullptr;
+        }
+    }
+
+  public:
+    inline StreamingBuffer() = default;
+
+    inline ~StreamingBuffer() {
+        release();
+    }
+
+    StreamingBuffer(const StreamingBuffer&) = delete;
+    StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+    inline unsigned int getBuffer() const {
+        return buffer;
+    }
+
+    inline std::size_t getRegionSize() const {
+        return regionSize;
+    }
+
+    inline int getRegion() const {
+        return region;
+    }
+
+    // Makes every region hold at least size bytes. Returns true if a new buffer was created, vertex array
+    // bindings of the old one have to be updated then.
+    inline bool reserve(std::size_t size) {
+        if (size <= regionSize) {
+            return false;
+        }
+
+        release();
+        regionSize = std::max(size, 2 * regionSize);
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, regionSize * regionCount, nullptr, flags);
+        mapped = static_cast<char*>(glMapNamedBufferRange(buffer, 0, regionSize * regionCount, flags));
+
+        if (mapped == nullptr) {
+            throw std::runtime_error("Failed to map the streaming buffer");
+        }
+
+        region = 0;
+        return true;
+    }
+
+    // moves on to the next region and returns it once the GPU no longer reads it
+    inline void* next() {
+        region = (region + 1) % regionCount;
+        waitFor(region);
+
+        return mapped + region * regionSize;
+    }
+
+    // called after the draw calls that read the current region
+    inline void fence() {
+        if (fences[region] != nullptr) {
+            glDeleteSync(fences[region]);
+        }
+
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+};
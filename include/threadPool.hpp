@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+  private:
+    int threadCount;
+    bool deterministic;
+
+    std::vector<std::thread> workers;
+
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable done;
+
+    const std::function<void(int, int)>* task = nullptr;
+    int taskCount = 0;
+    int nextTask = 0;
+    int busyWorkers = 0;
+    unsigned int generation = 0;
+    bool stop = false;
+
+    void work(int thread);
+    void workerLoop(int thread);
+
+  public:
+    // the calling thread takes part in every run, so threadCount - 1 workers are started
+    ThreadPool(int threadCount = static_cast<int>(std::thread::hardware_concurrency()), bool deterministic = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getThreadCount() const;
+
+    // results of a deterministic pool must not depend on the thread count
+    bool isDeterministic() const;
+
+    // calls task(index, thread) for every index in [0, taskCount) and blocks until all are done
+    void run(int taskCount, const std::function<void(int, int)>& task);
+
+    // wraps the task by reference, a std::function of a lambda that captures more than two pointers would allocate
+    template<typename TTask>
+    inline void run(int taskCount, const TTask& task) {
+        run(taskCount, std::function<void(int, int)>(std::cref(task)));
+    }
+
+    // calls body(begin, end, thread) for chunks of at most grainSize elements of [begin, end)
+    template<typename TBody>
+    inline void parallelFor(int begin, int end, const TBody& body, int grainSize = 1024) {
+        if (end <= begin) {
+            return;
+        }
+
+        if (threadCount == 1 || end - begin <= grainSize) {
+            body(begin, end, 0);
+            return;
+        }
+
+        const int chunkCount = (end - begin + grainSize - 1) / grainSize;
+        run(chunkCount, [&](int chunk, int thread) {
+            const int chunkBegin = begin + chunk * grainSize;
+            body(chunkBegin, std::min(chunkBegin + grainSize, end), thread);
+        });
+    }
+};
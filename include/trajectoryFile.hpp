@@ -0,0 +1,362 @@
+#pragma once
+#include "bytes.hpp"
+#include "snapshotCodec.hpp"
+#include "state.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// File layout: TrajectoryHeader, then one FrameHeader followed by its payload per frame and finally the
+// offsets of all frames, their count and indexMagic. The payload stores the columns of the state one
+// after another: positions, velocities, masses, radii, ids and attributes. Compressed files store SnapshotCodec
+// frames instead and have positive error bounds in the header.
+struct TrajectoryHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t dim;
+    std::uint32_t valueSize;
+    std::uint32_t attributeSize;
+    double stepSize;
+    double positionError;
+    double velocityError;
+};
+
+struct FrameHeader {
+    std::uint64_t time;
+    std::uint64_t count;
+    std::uint64_t payloadSize;
+};
+
+inline constexpr char trajectoryMagic[8] = {'G', 'R', 'A', 'V', 'T', 'R', 'A', 'J'};
+inline constexpr char indexMagic[8] = {'G', 'R', 'A', 'V', 'I', 'N', 'D', 'X'};
+inline constexpr std::uint32_t trajectoryVersion = 2;
+
+// read only memory mapping of a whole file
+class MappedFile {
+  private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#else
+    int file = -1;
+#endif
+
+  public:
+    MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    inline const char* getData() const {
+        return data;
+    }
+
+    inline std::size_t getSize() const {
+        return size;
+    }
+};
+
+// appends buffers to a file on a background thread
+class AsyncFileWriter {
+  private:
+    std::ofstream file;
+    std::thread writer;
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable drained;
+    std::deque<std::vector<char>> queue;
+    std::size_t queuedBytes = 0;
+    std::size_t maxQueuedBytes;
+    bool writing = false;
+    bool stop = false;
+
+    void writerLoop();
+
+  public:
+    // write blocks while more than maxQueuedBytes wait for a slow disk, a larger buffer is queued once the queue is empty
+    AsyncFileWriter(const std::string& path, std::size_t maxQueuedBytes = std::size_t(256) << 20);
+    ~AsyncFileWriter();
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    void write(std::vector<char>&& buffer);
+
+    // blocks until all queued buffers are written
+    void flush();
+};
+
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class TrajectoryWriter {
+    static_assert(std::is_trivially_copyable_v<T>, "The attributes are stored as raw bytes");
+
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Codec = SnapshotCodec<dim, TValue, T>;
+
+  private:
+    AsyncFileWriter file;
+    std::optional<Codec> codec;
+    int intraInterval;
+
+    std::uint64_t offset = 0;
+    std::vector<std::uint64_t> frameOffsets;
+    bool closed = false;
+
+    inline void append(std::vector<char>&& buffer) {
+        offset += buffer.size();
+        file.write(std::move(buffer));
+    }
+
+  public:
+    // Positive error bounds compress the frames, a new intra frame is started every intraInterval frames which
+    // bounds the cost of seeking.
+    inline TrajectoryWriter(const std::string& path, TValue stepSize, TValue positionError = 0, TValue velocityError = 0, int intraInterval = 64)
+        : file(path), intraInterval(intraInterval) {
+        if (positionError > 0) {
+            codec.emplace(positionError, velocityError);
+        }
+
+        TrajectoryHeader header;
+        std::memcpy(header.magic, trajectoryMagic, sizeof(header.magic));
+        header.version = trajectoryVersion;
+        header.dim = dim;
+        header.valueSize = sizeof(TValue);
+        header.attributeSize = sizeof(T);
+        header.stepSize = static_cast<double>(stepSize);
+        header.positionError = codec.has_value() ? static_cast<double>(positionError) : 0;
+        header.velocityError = codec.has_value() ? static_cast<double>(velocityError) : 0;
+
+        std::vector<char> buffer;
+        appendBytes(buffer, &header, 1);
+        append(std::move(buffer));
+    }
+
+    // a write error is lost here, call close to get it
+    inline ~TrajectoryWriter() {
+        try {
+            close();
+        }
+        catch (const std::exception&) {
+        }
+    }
+
+    // copies the state, the file is written in the background
+    inline void write(int time, const State& state) {
+        const std::size_t count = state.size();
+
+        FrameHeader header;
+        header.time = time;
+        header.count = count;
+        header.payloadSize = count * ((2 * dim + 2) * sizeof(TValue) + sizeof(int) + sizeof(T));
+
+        std::vector<char> buffer;
+        if (codec.has_value()) {
+            appendBytes(buffer, &header, 1);
+            codec->encode(state, buffer, frameOffsets.size() % intraInterval == 0);
+
+            header.payloadSize = buffer.size() - sizeof(FrameHeader);
+            std::memcpy(buffer.data(), &header, sizeof(FrameHeader));
+
+            frameOffsets.push_back(offset);
+            append(std::move(buffer));
+            return;
+        }
+
+        buffer.reserve(sizeof(FrameHeader) + header.payloadSize);
+        appendBytes(buffer, &header, 1);
+
+        for (int d = 0; d < dim; d++) {
+            appendBytes(buffer, state.positions[d].data(), count);
+        }
+        for (int d = 0; d < dim; d++) {
+            appendBytes(buffer, state.velocities[d].data(), count);
+        }
+        appendBytes(buffer, state.masses.data(), count);
+        appendBytes(buffer, state.radii.data(), count);
+        appendBytes(buffer, state.ids.data(), count);
+        appendBytes(buffer, state.attributes.data(), count);
+
+        frameOffsets.push_back(offset);
+        append(std::move(buffer));
+    }
+
+    // writes the frame index and waits for the writer, throws if writing the file failed
+    inline void close() {
+        if (closed) {
+            return;
+        }
+        closed = true;
+
+        const std::uint64_t frameCount = frameOffsets.size();
+
+        std::vector<char> buffer;
+        appendBytes(buffer, frameOffsets.data(), frameOffsets.size());
+        appendBytes(buffer, &frameCount, 1);
+        appendBytes(buffer, indexMagic, sizeof(indexMagic));
+        append(std::move(buffer));
+
+        file.flush();
+    }
+};
+
+template<int dim, typename TValue, ObjectAttributes<dim, TValue> T>
+class TrajectoryReader {
+    static_assert(std::is_trivially_copyable_v<T>, "The attributes are stored as raw bytes");
+
+  public:
+    using State = SoAState<dim, TValue, T>;
+    using Codec = SnapshotCodec<dim, TValue, T>;
+
+  private:
+    MappedFile file;
+    TrajectoryHeader header;
+    std::vector<std::uint64_t> frameOffsets;
+
+    mutable std::optional<Codec> codec = std::nullopt;
+    mutable int decodedFrame = -1;
+
+    inline const char* payload(int frame) const {
+        return file.getData() + frameOffsets[frame] + sizeof(FrameHeader);
+    }
+
+    template<typename TData>
+    inline TData load(std::size_t offset) const {
+        if (offset + sizeof(TData) > file.getSize()) {
+            throw std::runtime_error("Trajectory file is truncated");
+        }
+
+        TData result;
+        std::memcpy(&result, file.getData() + offset, sizeof(TData));
+        return result;
+    }
+
+    inline bool readIndex() {
+        if (file.getSize() < sizeof(TrajectoryHeader) + sizeof(std::uint64_t) + sizeof(indexMagic) ||
+            std::memcmp(file.getData() + file.getSize() - sizeof(indexMagic), indexMagic, sizeof(indexMagic)) != 0) {
+            return false;
+        }
+
+        const std::size_t countOffset = file.getSize() - sizeof(indexMagic) - sizeof(std::uint64_t);
+        const std::uint64_t frameCount = load<std::uint64_t>(countOffset);
+        if (frameCount * sizeof(std::uint64_t) > countOffset - sizeof(TrajectoryHeader)) {
+            return false;
+        }
+
+        frameOffsets.resize(frameCount);
+        std::memcpy(frameOffsets.data(), file.getData() + countOffset - frameCount * sizeof(std::uint64_t), frameCount * sizeof(std::uint64_t));
+        return true;
+    }
+
+    // files of interrupted runs have no index, their complete frames are still readable
+    inline void scanFrames() {
+        std::size_t offset = sizeof(TrajectoryHeader);
+        while (offset + sizeof(FrameHeader) <= file.getSize()) {
+            const FrameHeader frame = load<FrameHeader>(offset);
+            if (offset + sizeof(FrameHeader) + frame.payloadSize > file.getSize()) {
+                break;
+            }
+
+            frameOffsets.push_back(offset);
+            offset += sizeof(FrameHeader) + frame.payloadSize;
+        }
+    }
+
+  public:
+    inline TrajectoryReader(const std::string& path)
+        : file(path) {
+        header = load<TrajectoryHeader>(0);
+
+        if (std::memcmp(header.magic, trajectoryMagic, sizeof(header.magic)) != 0 || header.version != trajectoryVersion) {
+            throw std::runtime_error("Not a trajectory file: " + path);
+        }
+        if (header.dim != dim || header.valueSize != sizeof(TValue) || header.attributeSize != sizeof(T)) {
+            throw std::runtime_error("Trajectory file " + path + " was written with different simulation parameters");
+        }
+
+        if (!readIndex()) {
+            scanFrames();
+        }
+
+        if (header.positionError > 0) {
+            codec.emplace(static_cast<TValue>(header.positionError), static_cast<TValue>(header.velocityError));
+        }
+    }
+
+    inline int frameCount() const {
+        return static_cast<int>(frameOffsets.size());
+    }
+
+    inline TValue getStepSize() const {
+        return static_cast<TValue>(header.stepSize);
+    }
+
+    inline int getTime(int frame) const {
+        return static_cast<int>(load<FrameHeader>(frameOffsets[frame]).time);
+    }
+
+    // compressed frames are decoded from the last intra frame, or the last read frame when reading in order
+    inline void read(int frame, State& state) const {
+        if (codec.has_value()) {
+            int first = frame;
+            while (!Codec::isIntra(payload(first))) {
+                first--;
+            }
+
+            if (decodedFrame >= first && decodedFrame < frame) {
+                first = decodedFrame + 1;
+            }
+
+            for (int next = first; next <= frame; next++) {
+                codec->decode(payload(next), load<FrameHeader>(frameOffsets[next]).payloadSize, state);
+            }
+
+            decodedFrame = frame;
+            return;
+        }
+
+        const FrameHeader header = load<FrameHeader>(frameOffsets[frame]);
+        const std::size_t count = header.count;
+        const char* data = payload(frame);
+
+        if (header.payloadSize != count * ((2 * dim + 2) * sizeof(TValue) + sizeof(int) + sizeof(T))) {
+            throw std::runtime_error("Corrupt trajectory frame " + std::to_string(frame));
+        }
+
+        const auto copy = [&](auto& column) {
+            using Value = std::remove_reference_t<decltype(column)>::value_type;
+
+            column.resize(count);
+            std::memcpy(column.data(), data, count * sizeof(Value));
+            data += count * sizeof(Value);
+        };
+
+        for (int d = 0; d < dim; d++) {
+            copy(state.positions[d]);
+        }
+        for (int d = 0; d < dim; d++) {
+            copy(state.velocities[d]);
+        }
+        copy(state.masses);
+        copy(state.radii);
+        copy(state.ids);
+        copy(state.attributes);
+        state.rebuildIndices();
+    }
+};
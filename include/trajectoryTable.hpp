@@ -0,0 +1,206 @@
+#pragma once
+#include "state.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Positions and velocities of every body over time, one column per body and vector component, so reading the orbit
+// of one body touches only its own samples. Only the last length steps are kept, the columns are reserved for twice
+// that many samples and the older half is dropped once they are full, so appending does not allocate.
+template<int dim, typename TValue>
+class TrajectoryTable {
+  public:
+    using TVec = glm::vec<dim, TValue>;
+
+    // samples of one body every stride steps, the spans point into the table and are invalidated by the next step
+    class View {
+      private:
+        int objectID = -1;
+        int startTime = 0;
+        int stride = 1;
+        std::array<std::span<const TValue>, dim> positionColumns;
+        std::array<std::span<const TValue>, dim> velocityColumns;
+
+      public:
+        inline View() = default;
+
+        inline View(int objectID, int startTime, int stride, const std::array<std::span<const TValue>, dim>& positionColumns, const std::array<std::span<const TValue>, dim>& velocityColumns)
+            : objectID(objectID), startTime(startTime), stride(stride), positionColumns(positionColumns), velocityColumns(velocityColumns) {
+        }
+
+        inline int getObjectID() const {
+            return objectID;
+        }
+
+        inline int getStride() const {
+            return stride;
+        }
+
+        inline int size() const {
+            return (static_cast<int>(positionColumns[0].size()) + stride - 1) / stride;
+        }
+
+        inline bool empty() const {
+            return positionColumns[0].empty();
+        }
+
+        // time of the k-th sample
+        inline int time(int k) const {
+            return startTime + k * stride;
+        }
+
+        inline TVec position(int k) const {
+            TVec result;
+            for (int d = 0; d < dim; d++) {
+                result[d] = positionColumns[d][k * stride];
+            }
+
+            return result;
+        }
+
+        inline TVec velocity(int k) const {
+            TVec result;
+            for (int d = 0; d < dim; d++) {
+                result[d] = velocityColumns[d][k * stride];
+            }
+
+            return result;
+        }
+
+        // every stride-th value starting with the first is a sample
+        inline std::span<const TValue> positions(int d) const {
+            return positionColumns[d];
+        }
+
+        inline std::span<const TValue> velocities(int d) const {
+            return velocityColumns[d];
+        }
+    };
+
+  private:
+    // a body exists from its start time on until it is merged, so its samples are contiguous in time
+    struct Track {
+        int startTime = 0;
+        VectorColumns<dim, TValue> positions;
+        VectorColumns<dim, TValue> velocities;
+
+        inline int size() const {
+            return static_cast<int>(positions[0].size());
+        }
+    };
+
+    // indexed by the id
+    std::vector<Track> tracks;
+    // 0 keeps every sample
+    int length = 0;
+    int endTime = 0;
+
+    // first time that is still available
+    inline int windowStart() const {
+        return length > 0 ? endTime - length + 1 : 0;
+    }
+
+    inline void drop(Track& track, int count) {
+        for (int d = 0; d < dim; d++) {
+            track.positions[d].erase(track.positions[d].begin(), track.positions[d].begin() + count);
+            track.velocities[d].erase(track.velocities[d].begin(), track.velocities[d].begin() + count);
+        }
+        track.startTime += count;
+    }
+
+  public:
+    inline TrajectoryTable(int length = 0)
+        : length(length) {
+    }
+
+    // sample of the i-th body of the state
+    template<ObjectAttributes<dim, TValue> T>
+    inline void append(int time, const SoAState<dim, TValue, T>& state, int i) {
+        const int id = state.ids[i];
+        if (id >= static_cast<int>(tracks.size())) {
+            tracks.resize(id + 1);
+        }
+
+        Track& track = tracks[id];
+        if (track.size() == 0) {
+            track.startTime = time;
+            for (int d = 0; d < dim && length > 0; d++) {
+                track.positions[d].reserve(2 * length);
+                track.velocities[d].reserve(2 * length);
+            }
+        }
+        else if (length > 0 && track.size() == 2 * length) {
+            drop(track, length);
+        }
+
+        for (int d = 0; d < dim; d++) {
+            track.positions[d].push_back(state.positions[d][i]);
+            track.velocities[d].push_back(state.velocities[d][i]);
+        }
+        endTime = std::max(endTime, time);
+    }
+
+    template<ObjectAttributes<dim, TValue> T>
+    inline void append(int time, const SoAState<dim, TValue, T>& state) {
+        for (int i = 0; i < state.size(); i++) {
+            append(time, state, i);
+        }
+
+        // merged bodies get no more samples, their columns are released once the last one is out of the window
+        if (length > 0 && time % length == 0) {
+            for (Track& track : tracks) {
+                if (track.size() > 0 && track.startTime + track.size() <= windowStart()) {
+                    track = Track();
+                }
+            }
+        }
+    }
+
+    inline void clear() {
+        tracks.clear();
+        endTime = 0;
+    }
+
+    inline int getLength() const {
+        return length;
+    }
+
+    // number of ids, including the ones of bodies that were merged
+    inline int size() const {
+        return static_cast<int>(tracks.size());
+    }
+
+    inline std::size_t byteSize() const {
+        std::size_t result = 0;
+        for (const Track& track : tracks) {
+            result += 2 * dim * track.size() * sizeof(TValue);
+        }
+
+        return result;
+    }
+
+    // samples of the body within [begin, end), empty if it did not exist then
+    inline View get(int id, int begin, int end, int stride = 1) const {
+        if (id < 0 || id >= size() || tracks[id].size() == 0) {
+            return View();
+        }
+
+        const Track& track = tracks[id];
+        const int first = std::max({begin, track.startTime, windowStart()});
+        const int last = std::min(end, track.startTime + track.size());
+        const std::size_t offset = std::max(first - track.startTime, 0);
+        const std::size_t count = std::max(last - first, 0);
+
+        std::array<std::span<const TValue>, dim> positionColumns;
+        std::array<std::span<const TValue>, dim> velocityColumns;
+        for (int d = 0; d < dim; d++) {
+            positionColumns[d] = std::span<const TValue>(track.positions[d]).subspan(std::min(offset, track.positions[d].size()), count);
+            velocityColumns[d] = std::span<const TValue>(track.velocities[d]).subspan(std::min(offset, track.velocities[d].size()), count);
+        }
+
+        return View(id, first, stride, positionColumns, velocityColumns);
+    }
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include <numeric>
+#include <utility>
+#include <vector>
+
+// disjoint sets of the indices [0, count)
+class UnionFind {
+  private:
+    std::vector<int> parents;
+    std::vector<int> sizes;
+
+  public:
+    inline void reset(int count) {
+        parents.resize(count);
+        std::iota(parents.begin(), parents.end(), 0);
+        sizes.assign(count, 1);
+    }
+
+    inline int find(int index) {
+        while (parents[index] != index) {
+            // path halving
+            parents[index] = parents[parents[index]];
+            index = parents[index];
+        }
+
+        return index;
+    }
+
+    inline void unite(int first, int second) {
+        first = find(first);
+        second = find(second);
+
+        if (first == second) {
+            return;
+        }
+
+        if (sizes[first] < sizes[second]) {
+            std::swap(first, second);
+        }
+
+        parents[second] = first;
+        sizes[first] += sizes[second];
+    }
+};
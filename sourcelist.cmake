@@ -1,5 +1,15 @@
 set(SOURCES
+    src/checkpoint.cpp
     src/main.cpp
     src/renderer.cpp
+    src/simdKernel.cpp
     src/simulation.cpp
-    src/window.cpp)
\ No newline at end of file
+    src/threadPool.cpp
+    src/trajectoryFile.cpp
+    src/window.cpp)
+
+set(BENCH_SOURCES
+    bench/allocationCounter.cpp
+    bench/main.cpp
+    src/simdKernel.cpp
+    src/threadPool.cpp)
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+CheckpointWriter::CheckpointWriter() {
+    writer = std::thread(&CheckpointWriter::writerLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeUp.notify_one();
+
+    writer.join();
+}
+
+void CheckpointWriter::writerLoop() {
+    while (true) {
+        std::pair<std::string, std::vector<char>> checkpoint;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [&]() { return stop || pending.has_value(); });
+
+            // the last checkpoint is still written when stopping
+            if (!pending.has_value()) {
+                return;
+            }
+
+            checkpoint = std::move(pending.value());
+            pending = std::nullopt;
+            writing = true;
+        }
+
+        std::string result;
+        try {
+            writeFile(checkpoint.first, checkpoint.second);
+        }
+        catch (const std::exception& e) {
+            result = e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            writing = false;
+            if (!result.empty()) {
+                error = result;
+            }
+        }
+        drained.notify_all();
+    }
+}
+
+void CheckpointWriter::writeFile(const std::string& path, const std::vector<char>& buffer) {
+    const std::string temporaryPath = path + ".tmp";
+
+    std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("Failed to open " + temporaryPath);
+    }
+
+    bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && std::fflush(file) == 0;
+
+    // the data has to be on the disk before the rename makes it the checkpoint
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+        std::filesystem::remove(temporaryPath);
+        throw std::runtime_error("Failed to write " + temporaryPath);
+    }
+
+    std::filesystem::rename(temporaryPath, path);
+}
+
+void CheckpointWriter::checkError() {
+    if (!error.empty()) {
+        const std::string message = error;
+        error.clear();
+        throw std::runtime_error(message);
+    }
+}
+
+void CheckpointWriter::write(const std::string& path, std::vector<char>&& buffer) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        checkError();
+        pending = std::make_pair(path, std::move(buffer));
+    }
+    wakeUp.notify_one();
+}
+
+void CheckpointWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [&]() { return !pending.has_value() && !writing; });
+
+    checkError();
+}
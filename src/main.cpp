@@ -1,5 +1,15 @@
+#include "barnesHut.hpp"
+#include "checkpoint.hpp"
+#include "directSum.hpp"
+#include "frameQueue.hpp"
+#include "initialConditions.hpp"
+#include "mergeRule.hpp"
+#include "mixedPrecision.hpp"
+#include "particleMesh.hpp"
 #include "renderer.hpp"
+#include "simdKernel.hpp"
 #include "simulation.hpp"
+#include "trajectoryFile.hpp"
 #include "window.hpp"
 
 #include "mass.hpp"
@@ -7,7 +17,12 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <chrono>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <thread>
 
 using namespace std::chrono_literals;
@@ -16,41 +31,30 @@ using ValueType = double;
 const int dimension = 2;
 
 using Vec = glm::vec<dimension, ValueType>;
+using State = Simulation<dimension, ValueType, Mass>::State;
+using Accelerations = Simulation<dimension, ValueType, Mass>::Accelerations;
 
-Simulation<dimension, ValueType, Mass> runSimulation() {
-    Simulation<2, ValueType, Mass>::ForceCallback a = [](int index, const std::vector<Object<2, ValueType, Mass>>& objects) {
-        static constexpr ValueType G = 6.6743E-11;
+static constexpr ValueType G = 6.6743E-11;
+
+Simulation<dimension, ValueType, Mass>::ForceCallback perObjectForce() {
+    return [](int index, const State& objects) {
         Vec acceleration = Vec(0.0);
 
         for (int j = 0; j < objects.size(); j++) {
             if (j == index)
                 continue;
 
-            const Vec& distanceVec = objects[j].position - objects[index].position;
+            const Vec& distanceVec = objects.position(j) - objects.position(index);
             const ValueType distance = glm::sqrt(glm::dot(distanceVec, distanceVec));
 
-            acceleration += G * objects[j].attributes.mass / glm::pow(distance, 3.0f) * distanceVec;
+            acceleration += G * objects.masses[j] / glm::pow(distance, 3.0f) * distanceVec;
         }
 
         return acceleration;
     };
+}
 
-    Simulation<dimension, ValueType, Mass>::CollisionCallback onCollision = [](int index, const std::vector<int>& collisions, const std::vector<Object<dimension, ValueType, Mass>>& objects) {
-        float mass = objects[index].attributes.mass;
-        float radiusSquare = objects[index].attributes.radius * objects[index].attributes.radius;
-        Vec pos = static_cast<ValueType>(objects[index].attributes.mass) * objects[index].position;
-        Vec vel = static_cast<ValueType>(objects[index].attributes.mass) * objects[index].velocity;
-
-        for (int i : collisions) {
-            mass += objects[i].attributes.mass;
-            radiusSquare += objects[i].attributes.radius * objects[i].attributes.radius;
-            pos += static_cast<ValueType>(objects[i].attributes.mass) * objects[i].position;
-            vel += static_cast<ValueType>(objects[i].attributes.mass) * objects[i].velocity;
-        }
-
-        return Object<dimension, ValueType, Mass>(pos / static_cast<ValueType>(mass), vel / static_cast<ValueType>(mass), mass, glm::sqrt(radiusSquare));
-    };
-
+std::vector<Object<dimension, ValueType, Mass>> initialState() {
     std::vector<Object<dimension, ValueType, Mass>> objects;
 
     float density = 1E10f;
@@ -68,24 +72,223 @@ Simulation<dimension, ValueType, Mass> runSimulation() {
         objects.emplace_back(position, velocity, mass, radius);
     }
 
-    Simulation<dimension, ValueType, Mass> sim = Simulation<dimension, ValueType, Mass>(objects, a, onCollision);
+    return objects;
+}
+
+// returns the max relative error
+template<typename TEngine>
+ValueType compareForceEngine(const std::string& name, TEngine engine, const State& objects, const Accelerations& reference, ThreadPool& threadPool) {
+    using Clock = std::chrono::steady_clock;
+
+    Accelerations accelerations;
 
-    for (int i = 0; i < 5000; i++) {
-        sim.step();
+    const auto start = Clock::now();
+    engine(objects, accelerations, threadPool);
+    const std::chrono::duration<double, std::milli> time = Clock::now() - start;
+
+    ValueType maxError = 0, meanError = 0;
+    for (int i = 0; i < objects.size(); i++) {
+        const Vec& expected = gather<dimension, ValueType>(reference, i);
+        const ValueType error = glm::length(gather<dimension, ValueType>(accelerations, i) - expected) / glm::length(expected);
+        maxError = glm::max(maxError, error);
+        meanError += error / objects.size();
     }
 
-    return sim;
+    std::cout << name << ": " << time.count() << " ms, "
+              << "mean relative error " << meanError << ", max relative error " << maxError << std::endl;
+
+    return maxError;
+}
+
+// the simd kernels have to match the scalar reference on every instruction set the cpu supports
+bool checkError(const std::string& name, ValueType error, ValueType bound) {
+    if (error < bound) {
+        return true;
+    }
+
+    std::cerr << name << " exceeds the relative error bound " << bound << std::endl;
+    return false;
+}
+
+// false if an exact engine deviates from the reference
+bool compareForceEngines(const State& objects, ThreadPool& threadPool) {
+    using Clock = std::chrono::steady_clock;
+
+    Accelerations reference;
+    const auto start = Clock::now();
+    Simulation<dimension, ValueType, Mass>::perObject(perObjectForce())(objects, reference, threadPool);
+    const std::chrono::duration<double, std::milli> time = Clock::now() - start;
+
+    std::cout << "per object direct sum: " << time.count() << " ms" << std::endl;
+
+    bool passed = checkError("direct sum", compareForceEngine("direct sum", DirectSum<dimension, ValueType, Mass>(G), objects, reference, threadPool), 1E-12);
+
+    for (InstructionSet instructionSet : {SCALAR, AVX2, AVX512}) {
+        if (instructionSet <= detectInstructionSet()) {
+            const std::string simdName = std::string("simd direct sum ") + getInstructionSetName(instructionSet);
+            const std::string mixedName = std::string("mixed precision direct sum ") + getInstructionSetName(instructionSet);
+
+            passed &= checkError(simdName, compareForceEngine(simdName, SimdDirectSum<dimension, ValueType, Mass>(G, 0.0, instructionSet), objects, reference, threadPool), 1E-12);
+            // single precision pair interactions
+            passed &= checkError(mixedName, compareForceEngine(mixedName, MixedPrecisionDirectSum<dimension, ValueType, Mass>(G, 0.0, instructionSet), objects, reference, threadPool), 1E-4);
+        }
+    }
+
+    for (ValueType theta : {0.2, 0.5, 0.8, 1.0}) {
+        compareForceEngine("barnes-hut theta = " + std::to_string(theta), BarnesHut<dimension, ValueType, Mass>(G, theta), objects, reference, threadPool);
+    }
+
+    for (int gridSize : {64, 256}) {
+        compareForceEngine("particle mesh " + std::to_string(gridSize), ParticleMesh<dimension, ValueType, Mass>(G, gridSize), objects, reference, threadPool);
+        compareForceEngine("p3m " + std::to_string(gridSize), ParticleMesh<dimension, ValueType, Mass>(G, gridSize, 0.0, 1.25), objects, reference, threadPool);
+    }
+
+    return passed;
 }
 
-int main(int, char**) {
-    const Simulation<dimension, ValueType, Mass>& sim = runSimulation();
+struct Options {
+    std::optional<ValueType> theta = std::nullopt;
+    bool simd = false;
+    bool mixed = false;
+    std::optional<int> meshSize = std::nullopt;
+    ValueType split = 0;
+    int threadCount = 1;
+    bool deterministic = false;
+    bool compare = false;
+    HistoryPolicy history;
+    std::optional<std::string> recordPath = std::nullopt;
+    std::optional<std::string> replayPath = std::nullopt;
+    std::optional<std::string> initialPath = std::nullopt;
+    std::optional<std::string> checkpointPath = std::nullopt;
+    int checkpointInterval = 500;
+    std::optional<std::string> restartPath = std::nullopt;
+    ValueType compressionError = 0;
+    bool sweepAndPrune = false;
+    std::optional<FrameQueue<State>::Backpressure> stream = std::nullopt;
+    bool metrics = false;
+};
+
+void printMetrics(const Metrics& metrics) {
+    if constexpr (!metricsEnabled) {
+        std::cout << "metrics are disabled in this build" << std::endl;
+        return;
+    }
+
+    const double total = metrics.getTotalSeconds();
+    std::cout << metrics.steps << " steps in " << total * 1000.0 << " ms" << std::endl;
+
+    for (int phase = 0; phase < Metrics::PHASE_COUNT; phase++) {
+        const double seconds = metrics.seconds[phase];
+        std::cout << "  " << Metrics::getPhaseName(static_cast<Metrics::Phase>(phase)) << ": " << seconds * 1000.0 << " ms";
+        if (phase != Metrics::RECONSTRUCTION && total > 0) {
+            std::cout << " (" << 100.0 * seconds / total << " %)";
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "  force evaluations: " << metrics.forceEvaluations << " full, " << metrics.partialForceEvaluations << " partial" << std::endl
+              << "  pair interactions: " << metrics.pairInteractions << std::endl
+              << "  collisions: " << metrics.collisionCandidates << " candidates, " << metrics.collisions << " hits, " << metrics.merges << " merges" << std::endl
+              << "  history: " << metrics.bytesAllocated / 1024 << " KiB allocated, " << metrics.bytesCopied / 1024 << " KiB copied" << std::endl;
+}
+
+// onFrame is called with every new state and stops the simulation by returning false
+Simulation<dimension, ValueType, Mass> runSimulation(const Options& options, const std::function<bool(const State&)>& onFrame = nullptr) {
+    const Simulation<dimension, ValueType, Mass>::CollisionCallback onCollision = InelasticMerge<dimension, ValueType, Mass>();
+
+    Simulation<dimension, ValueType, Mass>::AccelerationCallback a = DirectSum<dimension, ValueType, Mass>(G);
+    if (options.theta.has_value()) {
+        a = BarnesHut<dimension, ValueType, Mass>(G, options.theta.value());
+    }
+    else if (options.mixed) {
+        a = MixedPrecisionDirectSum<dimension, ValueType, Mass>(G);
+    }
+    else if (options.simd) {
+        a = SimdDirectSum<dimension, ValueType, Mass>(G);
+    }
+    else if (options.meshSize.has_value()) {
+        a = ParticleMesh<dimension, ValueType, Mass>(G, options.meshSize.value(), 0.0, options.split);
+    }
+
+    const auto threadPool = std::make_shared<ThreadPool>(options.threadCount, options.deterministic);
+
+    // a restart replaces the whole state, so it starts from an empty one
+    State initial;
+    if (!options.restartPath.has_value()) {
+        if (options.initialPath.has_value()) {
+            initial = InitialConditions<dimension, ValueType, Mass>::load(options.initialPath.value(), *threadPool);
+        }
+        else {
+            initial = State(initialState());
+        }
+    }
+
+    Simulation<dimension, ValueType, Mass> sim = Simulation<dimension, ValueType, Mass>(std::move(initial), a, onCollision);
+    sim.setThreadPool(threadPool);
+    sim.setHistoryPolicy(options.history);
+    if (options.sweepAndPrune) {
+        sim.getBroadPhase().setMethod(BroadPhase<dimension, ValueType>::SWEEP_AND_PRUNE);
+    }
+
+    if (options.restartPath.has_value()) {
+        const MappedFile file(options.restartPath.value());
+        sim.loadCheckpoint(file.getData(), file.getSize());
+    }
+
+    std::optional<TrajectoryWriter<dimension, ValueType, Mass>> recorder = std::nullopt;
+    if (options.recordPath.has_value()) {
+        recorder.emplace(options.recordPath.value(), sim.stepSize, options.compressionError, options.compressionError);
+    }
+
+    std::optional<CheckpointWriter> checkpoints = std::nullopt;
+    if (options.checkpointPath.has_value()) {
+        checkpoints.emplace();
+    }
+
+    const int startTime = sim.endTime();
+    for (int time = startTime; time <= 5000; time++) {
+        if (time > startTime) {
+            sim.step();
+        }
+
+        const State& state = sim.getState(sim.endTime());
+        if (recorder.has_value()) {
+            recorder->write(sim.endTime(), state);
+        }
+
+        // only the latest state, the history would make every checkpoint larger
+        if (checkpoints.has_value() && time > startTime && time % options.checkpointInterval == 0) {
+            std::vector<char> buffer;
+            sim.saveCheckpoint(buffer, false);
+            checkpoints->write(options.checkpointPath.value(), std::move(buffer));
+        }
+
+        if (onFrame && !onFrame(state)) {
+            break;
+        }
+    }
+
+    if (checkpoints.has_value()) {
+        checkpoints->flush();
+    }
+    if (recorder.has_value()) {
+        recorder->close();
+    }
+
+    return sim;
+}
 
+// getFrame(index) returns the state shown in the given frame or nullptr if it is not available
+template<typename TGetFrame>
+void render(const TGetFrame& getFrame) {
     Window window;
     try {
         window.init();
 
         Renderer<dimension, ValueType> renderer(&window);
-        renderer.updateBuffers(sim.states.front());
+        if (const State* state = getFrame(0)) {
+            renderer.updateBuffers(*state);
+        }
 
         int index = 0;
         auto frameDuration = 5ms;
@@ -101,10 +304,9 @@ int main(int, char**) {
             lastTime = time;
             if (std::chrono::duration<float, std::milli>(timeSinceLastFrame * 1000.0f) > frameDuration) {
                 if (!pause) {
-                    index++;
-
-                    if (index < sim.endTime()) {
-                        renderer.updateBuffers(sim.getState(index));
+                    if (const State* state = getFrame(index + 1)) {
+                        renderer.updateBuffers(*state);
+                        index++;
                     }
                 }
                 timeSinceLastFrame = 0;
@@ -125,3 +327,148 @@ int main(int, char**) {
 
     window.close();
 }
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (arg == "--compare") {
+            options.compare = true;
+        }
+        else if (arg == "--theta" && i + 1 < argc) {
+            options.theta = std::stod(argv[++i]);
+        }
+        else if (arg == "--simd") {
+            options.simd = true;
+        }
+        else if (arg == "--mixed") {
+            options.mixed = true;
+        }
+        else if (arg == "--mesh" && i + 1 < argc) {
+            options.meshSize = std::stoi(argv[++i]);
+        }
+        else if (arg == "--split" && i + 1 < argc) {
+            options.split = std::stod(argv[++i]);
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            options.threadCount = std::stoi(argv[++i]);
+        }
+        else if (arg == "--deterministic") {
+            options.deterministic = true;
+        }
+        else if (arg == "--keyframe-interval" && i + 1 < argc) {
+            options.history.keyframeInterval = std::stoi(argv[++i]);
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            options.recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            options.replayPath = argv[++i];
+        }
+        else if (arg == "--initial" && i + 1 < argc) {
+            options.initialPath = argv[++i];
+        }
+        else if (arg == "--checkpoint" && i + 1 < argc) {
+            options.checkpointPath = argv[++i];
+        }
+        else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            options.checkpointInterval = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--restart" && i + 1 < argc) {
+            options.restartPath = argv[++i];
+        }
+        else if (arg == "--sweep-and-prune") {
+            options.sweepAndPrune = true;
+        }
+        else if (arg == "--compress" && i + 1 < argc) {
+            options.compressionError = std::stod(argv[++i]);
+            options.history.positionError = options.compressionError;
+            options.history.velocityError = options.compressionError;
+        }
+        else if (arg == "--stream" && i + 1 < argc) {
+            const std::string backpressure = argv[++i];
+            options.stream = backpressure == "block" ? FrameQueue<State>::BLOCK : FrameQueue<State>::DROP;
+        }
+        else if (arg == "--metrics") {
+            options.metrics = true;
+        }
+    }
+
+    if (options.compare) {
+        ThreadPool threadPool(options.threadCount, options.deterministic);
+        return compareForceEngines(initialState(), threadPool) ? 0 : 1;
+    }
+
+    if (options.replayPath.has_value()) {
+        const TrajectoryReader<dimension, ValueType, Mass> reader(options.replayPath.value());
+        State state;
+
+        render([&](int frame) -> const State* {
+            if (frame >= reader.frameCount()) {
+                return nullptr;
+            }
+
+            reader.read(frame, state);
+            return &state;
+        });
+        return 0;
+    }
+
+    if (options.stream.has_value()) {
+        // the frames are shown while they are computed, rewinding is not possible
+        FrameQueue<State> queue(64, options.stream.value());
+        Metrics metrics;
+        // a bad initial state or checkpoint ends the stream, the error is reported once the window is closed
+        std::exception_ptr error = nullptr;
+        std::thread producer([&]() {
+            try {
+                metrics = runSimulation(options, [&](const State& state) {
+                    queue.push(state);
+                    return !queue.isClosed();
+                }).metrics();
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+            queue.close();
+        });
+
+        State state;
+        render([&](int) -> const State* {
+            return queue.tryPop(state) ? &state : nullptr;
+        });
+
+        queue.close();
+        producer.join();
+
+        if (error) {
+            try {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception& e) {
+                std::cout << e.what() << std::endl;
+            }
+            return 1;
+        }
+
+        if (options.metrics) {
+            printMetrics(metrics);
+        }
+        return 0;
+    }
+
+    const Simulation<dimension, ValueType, Mass>& sim = runSimulation(options);
+
+    // a restarted run starts at the time of the checkpoint
+    render([&](int frame) -> const State* {
+        const int time = sim.startTime() + frame;
+        return time < sim.endTime() ? &sim.getState(time) : nullptr;
+    });
+
+    // includes the states reconstructed for the replay
+    if (options.metrics) {
+        printMetrics(sim.metrics());
+    }
+}
@@ -0,0 +1,381 @@
+#include "simdKernel.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_KERNEL_X86
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+
+namespace {
+    template<int dim, typename TValue>
+    inline void accumulate(int i, int jBegin, int jEnd, const TValue* const* targets, const TValue* const* positions, const TValue* masses, TValue softeningSquared, TValue* acceleration) {
+        for (int j = jBegin; j < jEnd; j++) {
+            TValue distance[dim];
+            TValue distanceSquared = softeningSquared;
+            for (int d = 0; d < dim; d++) {
+                distance[d] = positions[d][j] - targets[d][i];
+                distanceSquared += distance[d] * distance[d];
+            }
+
+            // self interaction
+            if (distanceSquared == 0) {
+                continue;
+            }
+
+            const TValue inverseDistance = static_cast<TValue>(1) / std::sqrt(distanceSquared);
+            const TValue factor = masses[j] * inverseDistance * inverseDistance * inverseDistance;
+            for (int d = 0; d < dim; d++) {
+                acceleration[d] += factor * distance[d];
+            }
+        }
+    }
+
+    template<int dim, typename TValue>
+    void scalarKernel(int begin, int end, const TValue* const* targets, int count, const TValue* const* positions, const TValue* masses, TValue G, TValue softening, TValue* const* accelerations) {
+        for (int i = begin; i < end; i++) {
+            TValue acceleration[dim] = {};
+            accumulate<dim, TValue>(i, 0, count, targets, positions, masses, softening * softening, acceleration);
+
+            for (int d = 0; d < dim; d++) {
+                accelerations[d][i] = G * acceleration[d];
+            }
+        }
+    }
+
+#ifdef SIMD_KERNEL_X86
+    TARGET_AVX2 inline float horizontalSum(__m256 value) {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+        return _mm_cvtss_f32(sum);
+    }
+
+    TARGET_AVX2 inline double horizontalSum(__m256d value) {
+        __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+        sum = _mm_add_sd(sum, _mm_unpackhi_pd(sum, sum));
+
+        return _mm_cvtsd_f64(sum);
+    }
+
+    template<int dim>
+    TARGET_AVX2 void avx2Kernel(int begin, int end, const float* const* targets, int count, const float* const* positions, const float* masses, float G, float softening, float* const* accelerations) {
+        constexpr int width = 8;
+        const int vectorEnd = count - count % width;
+
+        const __m256 softeningSquared = _mm256_set1_ps(softening * softening);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 threeHalves = _mm256_set1_ps(1.5f);
+
+        for (int i = begin; i < end; i++) {
+            __m256 position[dim];
+            __m256 acceleration[dim];
+            for (int d = 0; d < dim; d++) {
+                position[d] = _mm256_set1_ps(targets[d][i]);
+                acceleration[d] = zero;
+            }
+
+            for (int j = 0; j < vectorEnd; j += width) {
+                __m256 distance[dim];
+                __m256 distanceSquared = softeningSquared;
+                for (int d = 0; d < dim; d++) {
+                    distance[d] = _mm256_sub_ps(_mm256_loadu_ps(positions[d] + j), position[d]);
+                    distanceSquared = _mm256_fmadd_ps(distance[d], distance[d], distanceSquared);
+                }
+
+                // 12 bit estimate refined by one newton raphson step
+                __m256 inverseDistance = _mm256_rsqrt_ps(distanceSquared);
+                inverseDistance = _mm256_mul_ps(inverseDistance, _mm256_fnmadd_ps(_mm256_mul_ps(half, distanceSquared), _mm256_mul_ps(inverseDistance, inverseDistance), threeHalves));
+                inverseDistance = _mm256_and_ps(inverseDistance, _mm256_cmp_ps(distanceSquared, zero, _CMP_GT_OQ));
+
+                const __m256 factor = _mm256_mul_ps(_mm256_loadu_ps(masses + j), _mm256_mul_ps(inverseDistance, _mm256_mul_ps(inverseDistance, inverseDistance)));
+                for (int d = 0; d < dim; d++) {
+                    acceleration[d] = _mm256_fmadd_ps(factor, distance[d], acceleration[d]);
+                }
+            }
+
+            float sum[dim];
+            for (int d = 0; d < dim; d++) {
+                sum[d] = horizontalSum(acceleration[d]);
+            }
+            accumulate<dim, float>(i, vectorEnd, count, targets, positions, masses, softening * softening, sum);
+
+            for (int d = 0; d < dim; d++) {
+                accelerations[d][i] = G * sum[d];
+            }
+        }
+    }
+
+    template<int dim>
+    TARGET_AVX2 void avx2Kernel(int begin, int end, const double* const* targets, int count, const double* const* positions, const double* masses, double G, double softening, double* const* accelerations) {
+        constexpr int width = 4;
+        const int vectorEnd = count - count % width;
+
+        const __m256d softeningSquared = _mm256_set1_pd(softening * softening);
+        const __m256d zero = _mm256_setzero_pd();
+        const __m256d one = _mm256_set1_pd(1.0);
+
+        for (int i = begin; i < end; i++) {
+            __m256d position[dim];
+            __m256d acceleration[dim];
+            for (int d = 0; d < dim; d++) {
+                position[d] = _mm256_set1_pd(targets[d][i]);
+                acceleration[d] = zero;
+            }
+
+            for (int j = 0; j < vectorEnd; j += width) {
+                __m256d distance[dim];
+                __m256d distanceSquared = softeningSquared;
+                for (int d = 0; d < dim; d++) {
+                    distance[d] = _mm256_sub_pd(_mm256_loadu_pd(positions[d] + j), position[d]);
+                    distanceSquared = _mm256_fmadd_pd(distance[d], distance[d], distanceSquared);
+                }
+
+                // no double precision rsqrt before avx512
+                __m256d inverseDistance = _mm256_div_pd(one, _mm256_sqrt_pd(distanceSquared));
+                inverseDistance = _mm256_and_pd(inverseDistance, _mm256_cmp_pd(distanceSquared, zero, _CMP_GT_OQ));
+
+                const __m256d factor = _mm256_mul_pd(_mm256_loadu_pd(masses + j), _mm256_mul_pd(inverseDistance, _mm256_mul_pd(inverseDistance, inverseDistance)));
+                for (int d = 0; d < dim; d++) {
+                    acceleration[d] = _mm256_fmadd_pd(factor, distance[d], acceleration[d]);
+                }
+            }
+
+            double sum[dim];
+            for (int d = 0; d < dim; d++) {
+                sum[d] = horizontalSum(acceleration[d]);
+            }
+            accumulate<dim, double>(i, vectorEnd, count, targets, positions, masses, softening * softening, sum);
+
+            for (int d = 0; d < dim; d++) {
+                accelerations[d][i] = G * sum[d];
+            }
+        }
+    }
+
+    // The masked extracts sum in the same order as _mm512_reduce_add, which gcc 12 implements with undefined upper
+    // halves that -Wmaybe-uninitialized reports.
+    TARGET_AVX512 inline float horizontalSum(__m512 value) {
+        const __m128 low = _mm_add_ps(_mm512_maskz_extractf32x4_ps(0xF, value, 0), _mm512_maskz_extractf32x4_ps(0xF, value, 2));
+        const __m128 high = _mm_add_ps(_mm512_maskz_extractf32x4_ps(0xF, value, 1), _mm512_maskz_extractf32x4_ps(0xF, value, 3));
+        __m128 sum = _mm_add_ps(low, high);
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+        return _mm_cvtss_f32(sum);
+    }
+
+    TARGET_AVX512 inline double horizontalSum(__m512d value) {
+        return horizontalSum(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, value, 0), _mm512_maskz_extractf64x4_pd(0xF, value, 1)));
+    }
+
+    template<int dim>
+    TARGET_AVX512 void avx512Kernel(int begin, int end, const float* const* targets, int count, const float* const* positions, const float* masses, float G, float softening, float* const* accelerations) {
+        constexpr int width = 16;
+        const int vectorEnd = count - count % width;
+
+        const __m512 softeningSquared = _mm512_set1_ps(softening * softening);
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 half = _mm512_set1_ps(0.5f);
+        const __m512 threeHalves = _mm512_set1_ps(1.5f);
+
+        for (int i = begin; i < end; i++) {
+            __m512 position[dim];
+            __m512 acceleration[dim];
+            for (int d = 0; d < dim; d++) {
+                position[d] = _mm512_set1_ps(targets[d][i]);
+                acceleration[d] = zero;
+            }
+
+            for (int j = 0; j < vectorEnd; j += width) {
+                __m512 distance[dim];
+                __m512 distanceSquared = softeningSquared;
+                for (int d = 0; d < dim; d++) {
+                    distance[d] = _mm512_sub_ps(_mm512_loadu_ps(positions[d] + j), position[d]);
+                    distanceSquared = _mm512_fmadd_ps(distance[d], distance[d], distanceSquared);
+                }
+
+                // 14 bit estimate refined by one newton raphson step, all lanes are set by the mask
+                __m512 inverseDistance = _mm512_maskz_rsqrt14_ps(0xFFFF, distanceSquared);
+                inverseDistance = _mm512_mul_ps(inverseDistance, _mm512_fnmadd_ps(_mm512_mul_ps(half, distanceSquared), _mm512_mul_ps(inverseDistance, inverseDistance), threeHalves));
+
+                const __mmask16 valid = _mm512_cmp_ps_mask(distanceSquared, zero, _CMP_GT_OQ);
+                const __m512 factor = _mm512_maskz_mul_ps(valid, _mm512_loadu_ps(masses + j), _mm512_mul_ps(inverseDistance, _mm512_mul_ps(inverseDistance, inverseDistance)));
+                for (int d = 0; d < dim; d++) {
+                    acceleration[d] = _mm512_fmadd_ps(factor, distance[d], acceleration[d]);
+                }
+            }
+
+            float sum[dim];
+            for (int d = 0; d < dim; d++) {
+                sum[d] = horizontalSum(acceleration[d]);
+            }
+            accumulate<dim, float>(i, vectorEnd, count, targets, positions, masses, softening * softening, sum);
+
+            for (int d = 0; d < dim; d++) {
+                accelerations[d][i] = G * sum[d];
+            }
+        }
+    }
+
+    template<int dim>
+    TARGET_AVX512 void avx512Kernel(int begin, int end, const double* const* targets, int count, const double* const* positions, const double* masses, double G, double softening, double* const* accelerations) {
+        constexpr int width = 8;
+        const int vectorEnd = count - count % width;
+
+        const __m512d softeningSquared = _mm512_set1_pd(softening * softening);
+        const __m512d zero = _mm512_setzero_pd();
+        const __m512d half = _mm512_set1_pd(0.5);
+        const __m512d threeHalves = _mm512_set1_pd(1.5);
+
+        for (int i = begin; i < end; i++) {
+            __m512d position[dim];
+            __m512d acceleration[dim];
+            for (int d = 0; d < dim; d++) {
+                position[d] = _mm512_set1_pd(targets[d][i]);
+                acceleration[d] = zero;
+            }
+
+            for (int j = 0; j < vectorEnd; j += width) {
+                __m512d distance[dim];
+                __m512d distanceSquared = softeningSquared;
+                for (int d = 0; d < dim; d++) {
+                    distance[d] = _mm512_sub_pd(_mm512_loadu_pd(positions[d] + j), position[d]);
+                    distanceSquared = _mm512_fmadd_pd(distance[d], distance[d], distanceSquared);
+                }
+
+                // 14 bit estimate refined by two newton raphson steps, all lanes are set by the mask
+                __m512d inverseDistance = _mm512_maskz_rsqrt14_pd(0xFF, distanceSquared);
+                const __m512d halfDistanceSquared = _mm512_mul_pd(half, distanceSquared);
+                for (int k = 0; k < 2; k++) {
+                    inverseDistance = _mm512_mul_pd(inverseDistance, _mm512_fnmadd_pd(halfDistanceSquared, _mm512_mul_pd(inverseDistance, inverseDistance), threeHalves));
+                }
+
+                const __mmask8 valid = _mm512_cmp_pd_mask(distanceSquared, zero, _CMP_GT_OQ);
+                const __m512d factor = _mm512_maskz_mul_pd(valid, _mm512_loadu_pd(masses + j), _mm512_mul_pd(inverseDistance, _mm512_mul_pd(inverseDistance, inverseDistance)));
+                for (int d = 0; d < dim; d++) {
+                    acceleration[d] = _mm512_fmadd_pd(factor, distance[d], acceleration[d]);
+                }
+            }
+
+            double sum[dim];
+            for (int d = 0; d < dim; d++) {
+                sum[d] = horizontalSum(acceleration[d]);
+            }
+            accumulate<dim, double>(i, vectorEnd, count, targets, positions, masses, softening * softening, sum);
+
+            for (int d = 0; d < dim; d++) {
+                accelerations[d][i] = G * sum[d];
+            }
+        }
+    }
+#endif
+
+    template<typename TValue>
+    void dispatch(int dim, int begin, int end, const TValue* const* targets, int count, const TValue* const* positions, const TValue* masses, TValue G, TValue softening, TValue* const* accelerations, InstructionSet instructionSet) {
+        switch (instructionSet) {
+#ifdef SIMD_KERNEL_X86
+            case AVX512:
+                if (dim == 2) {
+                    avx512Kernel<2>(begin, end, targets, count, positions, masses, G, softening, accelerations);
+                }
+                else {
+                    avx512Kernel<3>(begin, end, targets, count, positions, masses, G, softening, accelerations);
+                }
+                break;
+            case AVX2:
+                if (dim == 2) {
+                    avx2Kernel<2>(begin, end, targets, count, positions, masses, G, softening, accelerations);
+                }
+                else {
+                    avx2Kernel<3>(begin, end, targets, count, positions, masses, G, softening, accelerations);
+                }
+                break;
+#endif
+            default:
+                if (dim == 2) {
+                    scalarKernel<2, TValue>(begin, end, targets, count, positions, masses, G, softening, accelerations);
+                }
+                else {
+                    scalarKernel<3, TValue>(begin, end, targets, count, positions, masses, G, softening, accelerations);
+                }
+                break;
+        }
+    }
+}
+
+InstructionSet detectInstructionSet() {
+#if defined(SIMD_KERNEL_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    const bool osSaves = (info[2] & (1 << 27)) != 0;
+    const bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osSaves || maxLeaf < 7) {
+        return SCALAR;
+    }
+
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+
+    if ((info[1] & (1 << 16)) && (xcr0 & 0xe6) == 0xe6) {
+        return AVX512;
+    }
+    if ((info[1] & (1 << 5)) && fma && (xcr0 & 0x6) == 0x6) {
+        return AVX2;
+    }
+
+    return SCALAR;
+#elif defined(SIMD_KERNEL_X86)
+    if (__builtin_cpu_supports("avx512f")) {
+        return AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return AVX2;
+    }
+
+    return SCALAR;
+#else
+    return SCALAR;
+#endif
+}
+
+const char* getInstructionSetName(InstructionSet instructionSet) {
+    switch (instructionSet) {
+        case AVX512:
+            return "avx512";
+        case AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+void directSumKernel(int dim, int begin, int end, int count, const float* const* positions, const float* masses, float G, float softening, float* const* accelerations, InstructionSet instructionSet) {
+    dispatch<float>(dim, begin, end, positions, count, positions, masses, G, softening, accelerations, instructionSet);
+}
+
+void directSumKernel(int dim, int begin, int end, const float* const* targets, int count, const float* const* positions, const float* masses, float G, float softening, float* const* accelerations, InstructionSet instructionSet) {
+    dispatch<float>(dim, begin, end, targets, count, positions, masses, G, softening, accelerations, instructionSet);
+}
+
+void directSumKernel(int dim, int begin, int end, int count, const double* const* positions, const double* masses, double G, double softening, double* const* accelerations, InstructionSet instructionSet) {
+    dispatch<double>(dim, begin, end, positions, count, positions, masses, G, softening, accelerations, instructionSet);
+}
+
+void directSumKernel(int dim, int begin, int end, const double* const* targets, int count, const double* const* positions, const double* masses, double G, double softening, double* const* accelerations, InstructionSet instructionSet) {
+    dispatch<double>(dim, begin, end, targets, count, positions, masses, G, softening, accelerations, instructionSet);
+}
@@ -0,0 +1,98 @@
+#include "threadPool.hpp"
+
+ThreadPool::ThreadPool(int threadCount, bool deterministic)
+    : threadCount(std::max(threadCount, 1)), deterministic(deterministic) {
+    for (int thread = 1; thread < this->threadCount; thread++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, thread);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeUp.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::getThreadCount() const {
+    return threadCount;
+}
+
+bool ThreadPool::isDeterministic() const {
+    return deterministic;
+}
+
+void ThreadPool::work(int thread) {
+    while (true) {
+        int index;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (nextTask >= taskCount) {
+                return;
+            }
+
+            index = nextTask++;
+        }
+
+        (*task)(index, thread);
+    }
+}
+
+void ThreadPool::workerLoop(int thread) {
+    unsigned int seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [&]() { return stop || generation != seenGeneration; });
+
+            if (stop) {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        work(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busyWorkers--;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::run(int taskCount, const std::function<void(int, int)>& task) {
+    if (workers.empty()) {
+        for (int i = 0; i < taskCount; i++) {
+            task(i, 0);
+        }
+
+        return;
+    }
+
+    // several simulations may share one pool
+    std::lock_guard<std::mutex> runLock(runMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->task = &task;
+        this->taskCount = taskCount;
+        nextTask = 0;
+        busyWorkers = static_cast<int>(workers.size());
+        generation++;
+    }
+    wakeUp.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return busyWorkers == 0; });
+    this->task = nullptr;
+}
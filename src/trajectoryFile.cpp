@@ -0,0 +1,164 @@
+#include "trajectoryFile.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path) {
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+
+    if (size > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping != nullptr) {
+            data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        }
+
+        if (data == nullptr) {
+            if (mapping != nullptr) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            throw std::runtime_error("Failed to map " + path);
+        }
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+        data = nullptr;
+    }
+    if (mapping != nullptr) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file != nullptr) {
+        CloseHandle(file);
+        file = nullptr;
+    }
+}
+#else
+MappedFile::MappedFile(const std::string& path) {
+    file = open(path.c_str(), O_RDONLY);
+    if (file == -1) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    struct stat status;
+    fstat(file, &status);
+    size = static_cast<std::size_t>(status.st_size);
+
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapped == MAP_FAILED) {
+            close(file);
+            throw std::runtime_error("Failed to map " + path);
+        }
+
+        data = static_cast<const char*>(mapped);
+        // frames are mostly replayed in order
+        madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    close(file);
+}
+#endif
+
+AsyncFileWriter::AsyncFileWriter(const std::string& path, std::size_t maxQueuedBytes)
+    : file(path, std::ios::binary | std::ios::trunc), maxQueuedBytes(maxQueuedBytes) {
+    if (!file) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    writer = std::thread(&AsyncFileWriter::writerLoop, this);
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wakeUp.notify_one();
+
+    writer.join();
+}
+
+void AsyncFileWriter::writerLoop() {
+    while (true) {
+        std::vector<char> buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [&]() { return stop || !queue.empty(); });
+
+            if (queue.empty()) {
+                return;
+            }
+
+            buffer = std::move(queue.front());
+            queue.pop_front();
+            queuedBytes -= buffer.size();
+            writing = true;
+        }
+
+        file.write(buffer.data(), buffer.size());
+
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle = queue.empty();
+        }
+
+        if (idle) {
+            file.flush();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            writing = false;
+        }
+        drained.notify_all();
+    }
+}
+
+void AsyncFileWriter::write(std::vector<char>&& buffer) {
+    {
+        // the writer notifies drained after every buffer it wrote
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [&]() { return queue.empty() || queuedBytes + buffer.size() <= maxQueuedBytes; });
+
+        queuedBytes += buffer.size();
+        queue.push_back(std::move(buffer));
+    }
+    wakeUp.notify_one();
+}
+
+void AsyncFileWriter::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    drained.wait(lock, [&]() { return queue.empty() && !writing; });
+
+    if (!file) {
+        throw std::runtime_error("Failed to write the trajectory file");
+    }
+}
@@ -0,0 +1,80 @@
+#include "allocationCounter.hpp"
+#include "barnesHut.hpp"
+#include "simulation.hpp"
+
+// mass.hpp uses the constants without including them
+#include <glm/gtc/constants.hpp>
+#include "mass.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Steps a simulation with collisions, recent states and trajectories until its buffers are sized and checks that
+// the following steps do not allocate. A single warm up step already has to size everything, buffers that only grow
+// now and then during the run would otherwise settle before the measurement.
+
+static constexpr int dimension = 2;
+using ValueType = double;
+using Sim = Simulation<dimension, ValueType, Mass>;
+using Vec = glm::vec<dimension, ValueType>;
+
+static constexpr int warmUpSteps = 1;
+static constexpr int measuredSteps = 50;
+
+std::uint64_t countAllocations(const Sim::AccelerationCallback& engine, int threadCount) {
+    std::mt19937_64 random(3);
+    std::uniform_real_distribution<ValueType> uniform(-400.0, 400.0);
+
+    // the masses and radii are small enough that no bodies merge, a merge would allocate the columns of a new id
+    std::vector<Object<dimension, ValueType, Mass>> objects;
+    for (int i = 0; i < 300; i++) {
+        const Vec position = {uniform(random), uniform(random)};
+        objects.emplace_back(position, static_cast<ValueType>(2.5) * glm::normalize(Vec{position.y, -position.x}), 1E6f, 0.05f);
+    }
+
+    Sim sim(objects, engine, Sim::CollisionCallback(InelasticMerge<dimension, ValueType, Mass>()));
+    sim.setThreadCount(threadCount);
+
+    // no keyframe falls into the measured steps, the trajectories are trimmed within them
+    HistoryPolicy history;
+    history.keyframeInterval = warmUpSteps + measuredSteps + 1;
+    history.recentStates = 1;
+    history.trajectories = true;
+    history.trajectoryLength = 8;
+    sim.setHistoryPolicy(history);
+
+    for (int i = 0; i < warmUpSteps; i++) {
+        sim.step();
+    }
+
+    const std::uint64_t allocations = allocationCount();
+    for (int i = 0; i < measuredSteps; i++) {
+        sim.step();
+    }
+
+    return allocationCount() - allocations;
+}
+
+int main() {
+    const ValueType G = 6.6743E-11;
+
+    bool passed = true;
+    const auto check = [&](const std::string& name, const Sim::AccelerationCallback& engine, int threadCount) {
+        const std::uint64_t allocations = countAllocations(engine, threadCount);
+        if (allocations > 0) {
+            std::cerr << name << ": " << allocations << " allocations in " << measuredSteps << " steps with " << threadCount << " threads" << std::endl;
+            passed = false;
+        }
+    };
+
+    for (int threadCount : {1, 2}) {
+        check("direct sum", DirectSum<dimension, ValueType, Mass>(G), threadCount);
+    }
+    // every thread traverses the tree with its own stack
+    check("barnes-hut", BarnesHut<dimension, ValueType, Mass>(G), 4);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,136 @@
+#include "mixedPrecision.hpp"
+#include "simdKernel.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the simd and the mixed precision direct sums on every instruction set the cpu supports to a scalar
+// reference in double, for both precisions, both dimensions and with and without softening. The bounds on the
+// relative error are the ones of --compare.
+
+struct Body {
+    float mass;
+    float radius;
+
+    template<int dim, typename TValue>
+    inline unsigned int getGeometry(const glm::vec<dim, TValue>&, std::vector<glm::vec<dim, TValue>>&, std::vector<unsigned int>&, unsigned int) const {
+        return 0;
+    }
+};
+
+static constexpr double G = 6.6743E-11;
+// not a multiple of any vector width, so the scalar tails are covered as well; with many more bodies some of them
+// feel nearly cancelling forces, where the float pairs of the mixed precision sum exceed its relative bound
+static constexpr int bodyCount = 509;
+
+int failures = 0;
+
+template<int dim, typename TValue>
+SoAState<dim, TValue, Body> createState() {
+    std::mt19937_64 random(11);
+    std::uniform_real_distribution<double> uniform(-400.0, 400.0);
+    std::uniform_real_distribution<float> masses(1E9f, 1E11f);
+
+    SoAState<dim, TValue, Body> state;
+    for (int i = 0; i < bodyCount; i++) {
+        glm::vec<dim, TValue> position;
+        for (int d = 0; d < dim; d++) {
+            position[d] = static_cast<TValue>(uniform(random));
+        }
+
+        state.setID(state.emplaceBack(position, glm::vec<dim, TValue>(0), masses(random), 1.0f), i);
+    }
+
+    return state;
+}
+
+template<int dim, typename TValue>
+std::vector<glm::vec<dim, double>> reference(const SoAState<dim, TValue, Body>& state, double softening) {
+    std::vector<glm::vec<dim, double>> result(state.size(), glm::vec<dim, double>(0));
+    for (int i = 0; i < state.size(); i++) {
+        for (int j = 0; j < state.size(); j++) {
+            if (i == j) {
+                continue;
+            }
+
+            const glm::vec<dim, double> distance = glm::vec<dim, double>(state.position(j)) - glm::vec<dim, double>(state.position(i));
+            const double distanceSquared = glm::dot(distance, distance) + softening * softening;
+            result[i] += G * state.masses[j] / (distanceSquared * std::sqrt(distanceSquared)) * distance;
+        }
+    }
+
+    return result;
+}
+
+// only the bodies in targets are compared, all of them if it is empty
+template<int dim, typename TValue>
+void check(const std::string& name, const VectorColumns<dim, TValue>& accelerations, const std::vector<glm::vec<dim, double>>& expected, const std::vector<int>& targets, double bound) {
+    double maxError = 0;
+    const int count = targets.empty() ? static_cast<int>(expected.size()) : static_cast<int>(targets.size());
+    for (int k = 0; k < count; k++) {
+        const int i = targets.empty() ? k : targets[k];
+        const glm::vec<dim, double> actual = glm::vec<dim, double>(gather<dim, TValue>(accelerations, i));
+        maxError = std::max(maxError, glm::length(actual - expected[i]) / glm::length(expected[i]));
+    }
+
+    if (!(maxError < bound)) {
+        std::cerr << name << ": max relative error " << maxError << " exceeds " << bound << std::endl;
+        failures++;
+    }
+}
+
+template<int dim, typename TValue>
+void checkEngines(ThreadPool& threadPool) {
+    const SoAState<dim, TValue, Body> state = createState<dim, TValue>();
+
+    std::vector<int> targets;
+    for (int i = 0; i < state.size(); i += 3) {
+        targets.push_back(i);
+    }
+
+    for (double softening : {0.0, 10.0}) {
+        const std::vector<glm::vec<dim, double>> expected = reference(state, softening);
+        // the simd kernels only lose the rounding of TValue, the mixed precision sum computes the pairs in float
+        const double bound = sizeof(TValue) == sizeof(double) ? 1E-12 : 1E-4;
+
+        for (InstructionSet instructionSet : {SCALAR, AVX2, AVX512}) {
+            if (instructionSet > detectInstructionSet()) {
+                continue;
+            }
+
+            const std::string suffix = std::string(" ") + getInstructionSetName(instructionSet) + " dim " + std::to_string(dim) + (sizeof(TValue) == sizeof(double) ? " double" : " float") + " softening " + std::to_string(softening);
+
+            SimdDirectSum<dim, TValue, Body> simd(static_cast<TValue>(G), static_cast<TValue>(softening), instructionSet);
+            VectorColumns<dim, TValue> accelerations;
+            simd(state, accelerations, threadPool);
+            check<dim, TValue>("simd direct sum" + suffix, accelerations, expected, {}, bound);
+
+            // the partial evaluation only writes the targets into sized columns
+            VectorColumns<dim, TValue> partial;
+            for (int d = 0; d < dim; d++) {
+                partial[d].assign(state.size(), static_cast<TValue>(0));
+            }
+            simd(state, targets, partial, threadPool);
+            check<dim, TValue>("simd direct sum targets" + suffix, partial, expected, targets, bound);
+
+            MixedPrecisionDirectSum<dim, TValue, Body> mixed(static_cast<TValue>(G), static_cast<TValue>(softening), instructionSet);
+            mixed(state, accelerations, threadPool);
+            check<dim, TValue>("mixed precision direct sum" + suffix, accelerations, expected, {}, 1E-4);
+        }
+    }
+}
+
+int main() {
+    ThreadPool threadPool(2);
+
+    checkEngines<2, float>(threadPool);
+    checkEngines<3, float>(threadPool);
+    checkEngines<2, double>(threadPool);
+    checkEngines<3, double>(threadPool);
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
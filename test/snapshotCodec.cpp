@@ -0,0 +1,106 @@
+#include "snapshotCodec.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Encodes a sequence of moving states, including a merge, and checks that every decoded component is within the
+// error bound and that the bodies are restored exactly.
+
+static constexpr int dimension = 3;
+using ValueType = double;
+
+struct Body {
+    float mass;
+    float radius;
+
+    template<int dim, typename TValue>
+    inline unsigned int getGeometry(const glm::vec<dim, TValue>&, std::vector<glm::vec<dim, TValue>>&, std::vector<unsigned int>&, unsigned int) const {
+        return 0;
+    }
+};
+
+using State = SoAState<dimension, ValueType, Body>;
+using Codec = SnapshotCodec<dimension, ValueType, Body>;
+
+static constexpr ValueType positionError = 1E-3;
+static constexpr ValueType velocityError = 1E-5;
+
+int failures = 0;
+
+void check(bool condition, const char* message, int frame) {
+    if (!condition) {
+        std::cerr << "frame " << frame << ": " << message << std::endl;
+        failures++;
+    }
+}
+
+void compare(const State& expected, const State& decoded, int frame) {
+    check(decoded.size() == expected.size(), "body count differs", frame);
+    check(decoded.ids == expected.ids, "ids differ", frame);
+    check(decoded.masses == expected.masses && decoded.radii == expected.radii, "masses or radii differ", frame);
+    if (decoded.size() != expected.size()) {
+        return;
+    }
+
+    for (int d = 0; d < dimension; d++) {
+        for (int i = 0; i < expected.size(); i++) {
+            // the rounding to the grid itself is exact up to the last bit of the value
+            check(std::abs(decoded.positions[d][i] - expected.positions[d][i]) <= positionError * (1 + 1E-9), "position error above the bound", frame);
+            check(std::abs(decoded.velocities[d][i] - expected.velocities[d][i]) <= velocityError * (1 + 1E-9), "velocity error above the bound", frame);
+        }
+    }
+}
+
+int main() {
+    std::mt19937_64 random(7);
+    std::uniform_real_distribution<ValueType> uniform(-1000.0, 1000.0);
+    std::normal_distribution<ValueType> normal(0.0, 1.0);
+
+    State state;
+    for (int i = 0; i < 500; i++) {
+        const int index = state.emplaceBack(glm::dvec3(uniform(random), uniform(random), uniform(random)), glm::dvec3(normal(random), normal(random), normal(random)), 1.0f + i, 0.5f);
+        state.setID(index, i);
+    }
+
+    Codec encoder(positionError, velocityError);
+    Codec decoder(positionError, velocityError);
+    State decoded;
+
+    std::size_t compressedSize = 0;
+    std::size_t rawSize = 0;
+    for (int frame = 0; frame < 100; frame++) {
+        for (int d = 0; d < dimension; d++) {
+            for (int i = 0; i < state.size(); i++) {
+                state.velocities[d][i] += 1E-3 * normal(random);
+                state.positions[d][i] += 0.1 * state.velocities[d][i];
+            }
+        }
+
+        // a body disappears, which forces an intra frame
+        if (frame == 50) {
+            state.erase(state.size() - 1);
+        }
+
+        std::vector<char> buffer;
+        encoder.encode(state, buffer, frame % 16 == 0);
+        check(Codec::isIntra(buffer.data()) == (frame % 16 == 0 || frame == 50), "unexpected frame type", frame);
+
+        decoder.decode(buffer.data(), buffer.size(), decoded);
+        compare(state, decoded, frame);
+
+        compressedSize += buffer.size();
+        rawSize += state.byteSize();
+    }
+
+    std::cout << "compressed to " << 100.0 * compressedSize / rawSize << " % of the raw states" << std::endl;
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}